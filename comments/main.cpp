@@ -12,7 +12,21 @@
 #include <fstream>
 #include <filesystem>
 
+#include "cache.hpp"
 #include "comments.hpp"
+#include "writer.hpp"
+
+static int run(Writer& out, std::string& content) {
+    std::string error = removeComments(content);
+    
+    if (error.empty()) {
+        out << content;
+        return 0;
+    } else {
+        out << error;
+        return 3;
+    }
+}
 
 int main(int argc, char* argv[]) {
 
@@ -33,14 +47,7 @@ int main(int argc, char* argv[]) {
     std::string content(size, '\0');
     inputFile.read(&content[0], size);
 
-    std::string error = removeComments(content);
-    
-    if (error.empty()) {
-        std::cout << content;
-        return 0;
-    } else {
-        std::cout << error;
-        return 3;
-    }
-    
+    Cache cache("comments", content);
+    Writer out(STDOUT_FILENO);
+    return cache.run(out, [&] { return run(out, content); });
 }
\ No newline at end of file
@@ -1,20 +1,171 @@
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <string_view>
+#include <thread>
 #include <vector>
 
+#include "cache.hpp"
 #include "comments.hpp"
 #include "tokenize.hpp"
 #include "cst.hpp"
+#include "cst_file.hpp"
+#include "flat_cst.hpp"
+#include "parser.hpp"
+#include "writer.hpp"
+
+// the tree and symbol table of a Cst, to compare it to another one
+static std::string dump(Cst& cst) {
+    std::string text;
+    {
+        Writer out(&text);
+        cst.print(out);
+        cst.table.print(out);
+    }
+    return text;
+}
+
+// an edit script has one edit per line, written "old => new", where \n stands for a
+// line break. Each one replaces the first occurrence of old in the source as edited
+// so far, without comments
+static std::string unescape(std::string_view s) {
+    std::string text;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '\\' && i + 1 < s.size() && s[i + 1] == 'n') {
+            text += '\n';
+            i++;
+        } else {
+            text += s[i];
+        }
+    }
+    return text;
+}
+
+// applies each edit of the script with Cst::edit(), and checks the tree against a parse
+// of the whole edited source. An edit that is rejected is left out of the source
+static int runEdits(Writer& out, std::string& content, const char* scriptPath, ParseLimits limits) {
+    std::ifstream script(scriptPath);
+    if (!script.is_open()) {
+        out << "ERROR: Failed to open edit script\n";
+        return 2;
+    }
+
+    std::string commentsError = removeComments(content);
+    if (!commentsError.empty()) {
+        out << commentsError;
+        return 3;
+    }
+
+    Tokenizer tokenizer(content);
+    Cst cst(&tokenizer, CstOptions{.incremental = true, .limits = limits});
+    if (!cst.ok()) {
+        out << cst.getError() << "\n";
+        return cst.getStatus() == ParseStatus::SyntaxError ? 0 : 6;
+    }
+
+    std::string line;
+    for (size_t n = 1; std::getline(script, line); n++) {
+        size_t arrow = line.find(" => ");
+        size_t offset = std::string::npos;
+        std::string old;
+        std::string inserted;
+        if (arrow != std::string::npos) {
+            old = unescape(line.substr(0, arrow));
+            inserted = unescape(line.substr(arrow + 4));
+            offset = content.find(old);
+        }
+        if (offset == std::string::npos) {
+            out << "ERROR: edit " << n << " is not \"old => new\" with old in the source\n";
+            return 2;
+        }
+
+        std::string edited = content;
+        edited.replace(offset, old.size(), inserted);
+        Tokenizer fullTokenizer(edited);
+        Cst full(&fullTokenizer);
+
+        out << "edit " << n << " on line " << std::count(content.begin(), content.begin() + offset, '\n') + 1 << ": ";
+        std::string before = dump(cst);
+        if (cst.edit(offset, old.size(), inserted)) {
+            out << (dump(cst) == dump(full) ? "reparsed, same as parsing the whole file\n"
+                                            : "reparsed, DIFFERENT from parsing the whole file\n");
+            content = std::move(edited);
+            continue;
+        }
+
+        out << "rejected\n";
+        if (!cst.getEditError().empty()) {
+            out << "    " << cst.getEditError() << "\n";
+        }
+        if (dump(cst) != before) {
+            out << "    but the tree or symbol table changed\n";
+        }
+        out << "    parsing the whole file: " << (full.ok() ? "no errors" : full.getError()) << "\n";
+    }
+
+    out << "\n";
+    cst.print(out);
+    out << "\n";
+    cst.table.print(out);
+    out << "\n";
+    return 0;
+}
 
 int main(int argc, char* argv[]) {
 
-    if (argc != 2) {
-        std::cout << "Usage: tokenize path/to/my-file.c\n";
+    // --stream:   print the tree while parsing instead of building it first
+    // --check:    only report the first syntax error, without building the tree
+    // --lazy:     parse function bodies when the tree is printed, instead of right away
+    // --parallel: parse function bodies, and print each definition, on one thread per core,
+    //             or on CHAGALITE_THREADS threads if it is set
+    // --exprs:    print the tree of every expression instead of the CST
+    // --lint:     report every syntax error instead of only the first, without building the tree
+    // --save out: also save the tree and symbol table to the file out
+    // --load:     print the tree saved in a file by --save, without parsing anything
+    // --get name: like --lazy, but only parse the body of the function or procedure name,
+    //             then print how many bodies are left, the syntax errors and the symbol table
+    // --edit script: apply the edits in script with Cst::edit(), checking each against a
+    //             parse of the whole edited file, then print the tree and symbol table
+    //
+    // --check and --lint exit with 4 if there is a syntax error, and --save with 5 if the
+    // file can't be written. A parse that goes over one of the limits set by
+    // CHAGALITE_MAX_NODES, CHAGALITE_MAX_BYTES, CHAGALITE_MAX_DEPTH or CHAGALITE_TIMEOUT_MS
+    // exits with 6
+    std::string_view mode = argc == 3 ? argv[1] : "";
+    bool stream = mode == "--stream";
+    bool check = mode == "--check";
+    bool lazy = mode == "--lazy";
+    bool parallel = mode == "--parallel";
+    bool exprs = mode == "--exprs";
+    bool lint = mode == "--lint";
+    bool load = mode == "--load";
+    const char* savePath = argc == 4 && std::string_view(argv[1]) == "--save" ? argv[2] : nullptr;
+    const char* editPath = argc == 4 && std::string_view(argv[1]) == "--edit" ? argv[2] : nullptr;
+    const char* getName = argc == 4 && std::string_view(argv[1]) == "--get" ? argv[2] : nullptr;
+
+    if (argc != 2 && !stream && !check && !lazy && !parallel && !exprs && !lint && !load && !savePath && !editPath && !getName) {
+        std::cout << "Usage: cst [--stream | --check | --lazy | --parallel | --exprs | --lint | --save out | --edit script | --get name] path/to/my-file.c\n";
+        std::cout << "       cst --load path/to/saved.cst\n";
         return 1;
     }
 
-    std::ifstream inputFile(argv[1]);
+    const char* path = argv[argc - 1];
+
+    if (load) {
+        CstFile file(path);
+        if (!file.ok()) {
+            std::cout << file.getError() << "\n";
+            return 2;
+        }
+        Writer out(STDOUT_FILENO);
+        file.print(out);
+        out << "\n";
+        return 0;
+    }
+
+    std::ifstream inputFile(path);
 
     if (!inputFile.is_open()) {
         std::cout << "ERROR: Failed to open file\n";
@@ -22,29 +173,127 @@ int main(int argc, char* argv[]) {
     }
 
     // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
-    auto size = std::filesystem::file_size(argv[1]);
+    auto size = std::filesystem::file_size(path);
     std::string content(size, '\0');
     inputFile.read(&content[0], size);
 
-    // strip comments
-    std::string commentsError = removeComments(content);
-    if (!commentsError.empty()) {
-        std::cout << commentsError;
-        return 3;
+    ParseLimits limits = ParseLimits::fromEnvironment();
+
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    if (const char* count = std::getenv("CHAGALITE_THREADS"); count && *count) {
+        threads = std::max(1ul, std::strtoul(count, nullptr, 10));
     }
 
-    Tokenizer tokenizer(content);
+    Writer out(STDOUT_FILENO);
 
-    Cst cst(&tokenizer);
+    // everything after reading the file, which prints to out and returns the exit code
+    auto run = [&]() -> int {
+        // strip comments
+        std::string commentsError = removeComments(content);
+        if (!commentsError.empty()) {
+            out << commentsError;
+            return 3;
+        }
 
-    if (!cst.ok()) {
-        std::cout << cst.getError() << "\n";
-    } else {
-        
-        cst.print();
-        std::cout << "\n";
+        Tokenizer tokenizer(content);
+        ParseStatus parseStatus;
+
+        if (check) {
+            std::string error = checkSyntax(&tokenizer, limits, &parseStatus);
+            if (!error.empty()) {
+                out << error << "\n";
+                return parseStatus == ParseStatus::SyntaxError ? 4 : 6;
+            }
+            return 0;
+        }
+
+        if (getName) {
+            Cst cst(&tokenizer, CstOptions{.lazy_bodies = true, .limits = limits});
+            if (!cst.getDefinition(getName)) {
+                out << "No function or procedure with a body named \"" << getName << "\"\n";
+            }
+            out << "Bodies left unparsed: " << cst.countUnparsed() << "\n";
+            for (const Diagnostic& d : cst.getDiagnostics()) {
+                out << "Syntax error on line " << d.line << ": " << d.message << "\n";
+            }
+            cst.table.print(out);
+            out << "\n";
+            return cst.getStatus() == ParseStatus::Ok || cst.getStatus() == ParseStatus::SyntaxError ? 0 : 6;
+        }
+
+        if (lint) {
+            std::vector<Diagnostic> errors = findSyntaxErrors(&tokenizer, limits, &parseStatus);
+            for (const Diagnostic& d : errors) {
+                out << "Syntax error on line " << d.line << ": " << d.message << "\n";
+            }
+            if (parseStatus != ParseStatus::Ok && parseStatus != ParseStatus::SyntaxError) {
+                return 6;
+            }
+            return errors.empty() ? 0 : 4;
+        }
+
+        Cst cst(&tokenizer, CstOptions{
+            .sink = stream ? &out : nullptr,
+            .lazy_bodies = lazy,
+            .threads = parallel ? threads : 0,
+            .expressions = exprs,
+            .limits = limits,
+        });
+
+        // bodies that were left for later may have syntax errors too
+        cst.expandAll();
+
+        if (!cst.ok()) {
+            if (stream) {
+                // part of the tree may already have been written, so all of what was
+                // parsed is kept, whatever the size of the buffer, and its last line
+                // ends before the error
+                out << "\n";
+            } else {
+                out.discard();
+            }
+            out << cst.getError() << "\n";
+            parseStatus = cst.getStatus();
+            if (parseStatus != ParseStatus::SyntaxError) {
+                return 6;
+            }
+        } else if (stream) {
+            out << "\n";
+        } else if (exprs) {
+            cst.printExpressions(out);
+        } else {
+            
+            if (parallel) {
+                cst.print(out, threads);
+            } else {
+                cst.print(out);
+            }
+            out << "\n";
+
+            if (savePath) {
+                std::string saveError = CstFile::save(savePath, cst.flatten(), cst.table);
+                if (!saveError.empty()) {
+                    out << saveError << "\n";
+                    return 5;
+                }
+            }
+        }
+
+
+        return 0;
+    };
+
+    // saving a file is a side effect that the cache can't replay
+    if (savePath) {
+        return run();
     }
 
+    // the output depends on the script, which isn't part of the key
+    if (editPath) {
+        return runEdits(out, content, editPath, limits);
+    }
 
-    return 0;
+    std::string options = getName ? "--get " + std::string(getName) : std::string(mode);
+    Cache cache("cst " + options + limits.describe(), content);
+    return cache.run(out, run);
 }
\ No newline at end of file
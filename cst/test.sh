@@ -1,7 +1,21 @@
 #!/bin/bash
 
 # diff the output with the expected result
-# the diff output is piped into cat -A to highlight trailing whitespace 
+# the diff output is piped into cat -A to highlight trailing whitespace
+#
+# tests in a subdirectory of $TESTS are run with the option of the same name (the
+# tests in $TESTS/stream with --stream), and compared to the same subdirectory of
+# $EXPECTED. The tests in $TESTS/save are saved with --save, and the saved file is
+# then printed with --load after what the first run printed. The tests in $TESTS/edit
+# are run with --edit and the edit script of the same name, like t1.edits for t1.c,
+# and the tests in $TESTS/get with --get and the name in the file of the same name, like
+# t1.get for t1.c. The tests in $TESTS/parallel run on 4 threads, and expect the same
+# output as without an option, and the tests in $TESTS/cache are run several times with
+# a cache of their own, see run_cache_test. The tests in $TESTS/limits are run without
+# an option, then with --check and --lint, with the environment variables in the file of
+# the same name (like t1.env for t1.c) set, and each run is followed by its exit status. $TESTS/generated has
+# scripts that print a program too big to check in, like t1.sh, which is run like the
+# limits tests and with --exprs, keeping only the last two lines of each output
 
 TESTS=tests
 EXPECTED=expected
@@ -29,29 +43,114 @@ if [ ! -x "$BINARY" ]; then
     exit 1
 fi
 
-shopt -s nullglob
-for i in "$TESTS"/*.$TEST_EXT; do
-    echo "Testing file $i:";
-    BN=$(basename "$i" .$TEST_EXT)
-    "$BINARY" "$i" > "$OUTPUT/o$BN.$OUTPUT_EXT"
-    if [ ! -f "$OUTPUT/o$BN.$OUTPUT_EXT" ]; then
-        echo -e "\e[1;31mFailed to create file \"$OUTPUT/o$BN.$OUTPUT_EXT\"\e[0m"
-        exit 1
-    fi
-    if [ ! -f "$EXPECTED/e$BN.$OUTPUT_EXT" ]; then
-        echo -e "\e[1;31mNo matching reference file \"$EXPECTED/e$BN.$OUTPUT_EXT\"\e[0m"
-        exit 1
-    fi
-    DIFF=$(diff "$OUTPUT/o$BN.$OUTPUT_EXT" "$EXPECTED/e$BN.$OUTPUT_EXT" | cat -A)
-    if [ -n "$DIFF" ]; then
-        echo -e "\e[0;33mDifferences between $OUTPUT/o$BN.$OUTPUT_EXT and $EXPECTED/e$BN.$OUTPUT_EXT:\e[0m"
-        echo "$DIFF"
-        echo -e "\e[1;31mSome test(s) failed\e[0m"
-        exit 1
+# run_cache_test <test file> <output file>
+# runs the test several times with a cache of its own. Each run is followed by its exit
+# status and how many entries the cache has, and then "(replayed)" is added to the end of
+# every entry, so that a run that replays one prints it
+run_cache_test() {
+    local CACHE="$2.cache"
+    local RESULT="$2"
+    rm -rf "$CACHE"
+    : > "$RESULT"
+
+    # cached <title> <command>...
+    cached() {
+        echo "== $1" >> "$RESULT"
+        shift
+        CHAGALITE_CACHE_DIR="$CACHE" "$@" >> "$RESULT"
+        echo "Exit status: $?, entries: $(ls "$CACHE" | wc -l)" >> "$RESULT"
+        for E in "$CACHE"/*; do
+            grep -qx "(replayed)" "$E" || echo "(replayed)" >> "$E"
+        done
+    }
+
+    cached "first run" "$BINARY" "$1"
+    cached "same run" "$BINARY" "$1"
+    cached "other option" "$BINARY" --check "$1"
+    cached "other limit" env CHAGALITE_MAX_DEPTH=100 "$BINARY" "$1"
+    cp "$1" "$2.c" && echo >> "$2.c"
+    cached "edited source" "$BINARY" "$2.c"
+    cp "$BINARY" "$2.bin"
+    cached "other build" "$2.bin" "$1"
+    rm -f "$2.bin"
+    cached "limit hit, not cached" env CHAGALITE_MAX_NODES=5 "$BINARY" "$1"
+
+    # entries of the same size, in a cache that only fits two of them
+    rm -rf "$CACHE"
+    cached "evict: first" env CHAGALITE_MAX_NODES=100001 "$BINARY" --check "$1"
+    local MAX=$((2 * $(cat "$CACHE"/* | wc -c)))
+    cached "evict: second" env CHAGALITE_MAX_NODES=100002 CHAGALITE_CACHE_MAX_BYTES=$MAX "$BINARY" --check "$1"
+    cached "evict: third, the first is removed" env CHAGALITE_MAX_NODES=100003 CHAGALITE_CACHE_MAX_BYTES=$MAX "$BINARY" --check "$1"
+    cached "evict: second again" env CHAGALITE_MAX_NODES=100002 CHAGALITE_CACHE_MAX_BYTES=$MAX "$BINARY" --check "$1"
+    cached "evict: fourth, the third is removed" env CHAGALITE_MAX_NODES=100004 CHAGALITE_CACHE_MAX_BYTES=$MAX "$BINARY" --check "$1"
+    cached "evict: second again" env CHAGALITE_MAX_NODES=100002 CHAGALITE_CACHE_MAX_BYTES=$MAX "$BINARY" --check "$1"
+    cached "evict: third again" env CHAGALITE_MAX_NODES=100003 CHAGALITE_CACHE_MAX_BYTES=$MAX "$BINARY" --check "$1"
+}
+
+# run_test <test file> <mode, or empty for the default> <output file>
+run_test() {
+    if [ -z "$2" ]; then
+        "$BINARY" "$1" > "$3"
+    elif [ "$2" = "save" ]; then
+        "$BINARY" --save "$3.cst" "$1" > "$3"
+        "$BINARY" --load "$3.cst" >> "$3"
+    elif [ "$2" = "edit" ]; then
+        "$BINARY" --edit "${1%.$TEST_EXT}.edits" "$1" > "$3"
+    elif [ "$2" = "get" ]; then
+        "$BINARY" --get "$(cat "${1%.$TEST_EXT}.get")" "$1" > "$3"
+    elif [ "$2" = "cache" ]; then
+        run_cache_test "$1" "$3"
+    elif [ "$2" = "parallel" ]; then
+        # the same number of threads on every machine, more than some tests have bodies
+        CHAGALITE_THREADS=4 "$BINARY" --parallel "$1" > "$3"
+    elif [ "$2" = "generated" ]; then
+        bash "$1" > "$3.c"
+        : > "$3"
+        for MODE in "" --check --lint --exprs; do
+            "$BINARY" $MODE "$3.c" | tail -n 2 | cut -c -80 >> "$3"
+            echo "Exit status: ${PIPESTATUS[0]}" >> "$3"
+        done
+    elif [ "$2" = "limits" ]; then
+        : > "$3"
+        for MODE in "" --check --lint; do
+            env $(cat "${1%.$TEST_EXT}.env") "$BINARY" $MODE "$1" >> "$3"
+            echo "Exit status: $?" >> "$3"
+        done
+    else
+        "$BINARY" "--$2" "$1" > "$3"
     fi
+}
+
+shopt -s nullglob
+for DIR in "" $(cd "$TESTS" && ls -d */ 2>/dev/null | tr -d /); do
+    mkdir -p "$OUTPUT/$DIR"
+    EXT=$TEST_EXT
+    [ "$DIR" = "generated" ] && EXT=sh
+    for i in "$TESTS/${DIR:+$DIR/}"*.$EXT; do
+        echo "Testing file $i${DIR:+ (--$DIR)}:";
+        BN=$(basename "$i" .$EXT)
+        OUT="$OUTPUT/${DIR:+$DIR/}o$BN.$OUTPUT_EXT"
+        REF="$EXPECTED/${DIR:+$DIR/}e$BN.$OUTPUT_EXT"
+        run_test "$i" "$DIR" "$OUT"
+        if [ ! -f "$OUT" ]; then
+            echo -e "\e[1;31mFailed to create file \"$OUT\"\e[0m"
+            exit 1
+        fi
+        if [ ! -f "$REF" ]; then
+            echo -e "\e[1;31mNo matching reference file \"$REF\"\e[0m"
+            exit 1
+        fi
+        DIFF=$(diff "$OUT" "$REF" | cat -A)
+        if [ -n "$DIFF" ]; then
+            echo -e "\e[0;33mDifferences between $OUT and $REF:\e[0m"
+            echo "$DIFF"
+            echo -e "\e[1;31mSome test(s) failed\e[0m"
+            exit 1
+        fi
+    done
 done
 
-if test -n "$(find "$TESTS" -maxdepth 1 -name "*.$TEST_EXT" -print -quit)"; then
+if test -n "$(find "$TESTS" -name "*.$TEST_EXT" -print -quit)"; then
     echo -e "\e[1;32mAll tests passed\e[0m"
 else
     echo -e "\e[1;33mNo tests found in $TESTS\e[0m"
@@ -0,0 +1,9 @@
+// a valid program
+
+procedure main (void)
+{
+  int n;
+
+  n = 1;
+  printf ("%d\n", n);
+}
@@ -0,0 +1,8 @@
+// a syntax error, whose exit status is replayed too
+
+procedure main (void)
+{
+  int n;
+
+  n = n + ;
+}
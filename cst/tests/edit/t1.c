@@ -0,0 +1,26 @@
+// edited by t1.edits: each edit is checked against a parse of the whole edited file
+
+int count;
+
+function int combine (int a, int b)
+{
+  int y;
+  y = a + b;
+  return y;
+}
+
+function int twice (int a)
+{
+  int unused;
+  int doubled;
+  doubled = a * 2;
+  return doubled;
+}
+
+procedure main (void)
+{
+  int n;
+  n = 3;
+  count = combine (n, n);
+  n = twice (count);
+}
@@ -0,0 +1,33 @@
+// one of each kind of expression node: chains of each precedence, binary relational
+// and ^ operators, unary operators, indexing, calls and literals
+
+function int add (int a, int b)
+{
+  return a + b;
+}
+
+procedure main (void)
+{
+  int x;
+  int y;
+  int arr[10];
+  bool f;
+  char c;
+
+  x = 1 + 2 - 3 + 4;
+  y = x * 2 / 3 % 4;
+  y = 2 ^ 3 ^ 2;
+  x = -y + arr[x + 1] * add(x, y);
+  if ((x < y) && (y >= 3) || (x == 1))
+  {
+    f = true;
+  }
+  f = !f;
+  c = 'a';
+  y = add(x, y) * 2;
+  printf ("%d\n", y);
+  while ((x <= 10) && (!f))
+  {
+    x = x + (y - 2) * 3;
+  }
+}
@@ -0,0 +1,11 @@
+# one expression with 100000 additions
+
+echo "procedure main (void)"
+echo "{"
+echo "  int a;"
+echo ""
+echo "  a = 1;"
+printf "  a = "
+printf "a + %.0s" $(seq 100000)
+echo "1;"
+echo "}"
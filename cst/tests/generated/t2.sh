@@ -0,0 +1,14 @@
+# one condition with 100000 comparisons joined by &&
+
+echo "procedure main (void)"
+echo "{"
+echo "  int a;"
+echo ""
+echo "  a = 1;"
+printf "  if ("
+printf "(a < 1) && %.0s" $(seq 100000)
+echo "(a > 0))"
+echo "  {"
+echo "    a = 0;"
+echo "  }"
+echo "}"
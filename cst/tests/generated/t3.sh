@@ -0,0 +1,11 @@
+# 50000 nested ifs, more than the default depth limit
+
+echo "procedure main (void)"
+echo "{"
+echo "  int a;"
+echo ""
+echo "  a = 1;"
+printf "if (a > 0) {\n%.0s" $(seq 50000)
+echo "a = 0;"
+printf "}\n%.0s" $(seq 50000)
+echo "}"
@@ -0,0 +1,22 @@
+// only the bodies of twice and main are parsed, since main's always is. The syntax
+// error in combine is not found, and the locals of combine are not in the symbol table
+
+function int combine (int a, int b)
+{
+  int y;
+  y = a + ;
+  return y;
+}
+
+function int twice (int a)
+{
+  int doubled;
+  doubled = a * 2;
+  return doubled;
+}
+
+procedure main (void)
+{
+  int n;
+  n = twice (3);
+}
@@ -0,0 +1,22 @@
+// the body of combine is parsed once it is asked for, and its syntax error is reported
+// like any other
+
+function int combine (int a, int b)
+{
+  int y;
+  y = a + ;
+  return y;
+}
+
+function int twice (int a)
+{
+  int doubled;
+  doubled = a * 2;
+  return doubled;
+}
+
+procedure main (void)
+{
+  int n;
+  n = twice (3);
+}
@@ -0,0 +1,10 @@
+// stops after 20 nodes
+
+procedure main (void)
+{
+  int n;
+
+  n = 1;
+  n = n + 1;
+  printf ("n = %d\n", n);
+}
@@ -0,0 +1,10 @@
+// stops once the nodes need more than 1000 bytes
+
+procedure main (void)
+{
+  int n;
+
+  n = 1;
+  n = n + 1;
+  printf ("n = %d\n", n);
+}
@@ -0,0 +1,16 @@
+// only the inner if goes over 12 rules deep
+
+procedure main (void)
+{
+  int n;
+
+  n = 1;
+  n = n + 1;
+  if (n > 0)
+  {
+    if (n > 1)
+    {
+      n = 0;
+    }
+  }
+}
@@ -0,0 +1,12 @@
+// every limit is set, but none is reached
+
+procedure main (void)
+{
+  int n;
+
+  n = 1;
+  if (n > 0)
+  {
+    n = n + 1;
+  }
+}
@@ -0,0 +1,33 @@
+// every syntax error of a program, each found after recovering from the one before
+
+int count
+int limit;
+
+function int twice (int n)
+{
+  int doubled;
+  doubled = n * ;
+  return doubled;
+}
+
+procedure report (int n)
+{
+  printf ("%d\n" n);
+  if (n > 2)
+  {
+    n = n + 1
+  }
+}
+
+int 5;
+
+procedure main (void)
+{
+  int x;
+  x = twice (limit);
+  for (x = 0; x < 3; x = x + 1)
+  {
+    report (x);
+  }
+  x = = 2;
+}
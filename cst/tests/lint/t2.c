@@ -0,0 +1,11 @@
+procedure main (void)
+{
+  int x;
+  x = 1;
+}
+stray tokens after main;
+procedure more (void)
+{
+  int y;
+  y = ;
+}
@@ -0,0 +1,18 @@
+// broken statements right after each other are each reported, and strings that read
+// like keywords are not taken for the start of a definition
+
+procedure main (void)
+{
+  int a;
+  a = 1 + ;
+  a = 1 + ;
+  printf ("function");
+  a = 2 * ;
+  printf ("int");
+  if (a < )
+  {
+    a = 3;
+  }
+  printf ("%d" "procedure" a);
+  a = 4 - ;
+}
@@ -0,0 +1,124 @@
+// more bodies than threads, with declarations between them
+
+int total;
+
+function int add_1 (int n)
+{
+  int m;
+
+  m = n + 1;
+  if (m > 10)
+  {
+    m = m - 1;
+  }
+  return m;
+}
+
+function int add_2 (int n)
+{
+  int m;
+
+  m = n + 2;
+  if (m > 20)
+  {
+    m = m - 2;
+  }
+  return m;
+}
+
+function int add_3 (int n)
+{
+  int m;
+
+  m = n + 3;
+  if (m > 30)
+  {
+    m = m - 3;
+  }
+  return m;
+}
+
+int count_3;
+
+function int add_4 (int n)
+{
+  int m;
+
+  m = n + 4;
+  if (m > 40)
+  {
+    m = m - 4;
+  }
+  return m;
+}
+
+function int add_5 (int n)
+{
+  int m;
+
+  m = n + 5;
+  if (m > 50)
+  {
+    m = m - 5;
+  }
+  return m;
+}
+
+function int add_6 (int n)
+{
+  int m;
+
+  m = n + 6;
+  if (m > 60)
+  {
+    m = m - 6;
+  }
+  return m;
+}
+
+int count_6;
+
+function int add_7 (int n)
+{
+  int m;
+
+  m = n + 7;
+  if (m > 70)
+  {
+    m = m - 7;
+  }
+  return m;
+}
+
+function int add_8 (int n)
+{
+  int m;
+
+  m = n + 8;
+  if (m > 80)
+  {
+    m = m - 8;
+  }
+  return m;
+}
+
+function int add_9 (int n)
+{
+  int m;
+
+  m = n + 9;
+  if (m > 90)
+  {
+    m = m - 9;
+  }
+  return m;
+}
+
+int count_9;
+
+procedure main (void)
+{
+  total = add_1 (1);
+  total = add_9 (total);
+  printf ("%d\n", total);
+}
@@ -0,0 +1,14 @@
+// fewer bodies than threads
+
+function int twice (int n)
+{
+  return n * 2;
+}
+
+procedure main (void)
+{
+  int n;
+
+  n = twice (21);
+  printf ("%d\n", n);
+}
@@ -0,0 +1,32 @@
+// syntax errors in two bodies, only the first is reported
+
+function int first (int n)
+{
+  return n + 1;
+}
+
+function int second (int n)
+{
+  int m;
+
+  m = n + ;
+  return m;
+}
+
+function int third (int n)
+{
+  return n - 1;
+}
+
+function int fourth (int n)
+{
+  int m;
+
+  m = * n;
+  return m;
+}
+
+procedure main (void)
+{
+  printf ("%d\n", first (1));
+}
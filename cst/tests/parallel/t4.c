@@ -0,0 +1,18 @@
+// a syntax error outside of any body, after the bodies
+
+function int first (int n)
+{
+  return n + 1;
+}
+
+function int second (int n)
+{
+  return n + 2;
+}
+
+int char;
+
+procedure main (void)
+{
+  printf ("%d\n", second (1));
+}
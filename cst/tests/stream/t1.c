@@ -0,0 +1,11 @@
+// the tree parsed before the syntax error is kept, however much of it was flushed
+
+procedure main (void)
+{
+  int n;
+
+  n = 0;
+  n = n + 1;
+  n = n + ;
+  n = n + 1;
+}
@@ -0,0 +1,196 @@
+#include "cache.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// FNV-1a, continuing from h
+uint64_t fnv1a(std::string_view bytes, uint64_t h = 0xcbf29ce484222325) {
+    for (unsigned char c : bytes) {
+        h = (h ^ c) * 0x100000001b3;
+    }
+    return h;
+}
+
+// the size and modification time of the running executable, or 0 if they are unknown
+uint64_t build_id() {
+    struct stat info;
+    if (::stat("/proc/self/exe", &info) != 0) {
+        return 0;
+    }
+    uint64_t h = fnv1a(std::string_view(reinterpret_cast<const char*>(&info.st_size), sizeof(info.st_size)));
+    h = fnv1a(std::string_view(reinterpret_cast<const char*>(&info.st_mtim.tv_sec), sizeof(info.st_mtim.tv_sec)), h);
+    return fnv1a(std::string_view(reinterpret_cast<const char*>(&info.st_mtim.tv_nsec), sizeof(info.st_mtim.tv_nsec)), h);
+}
+
+// true for the names of entries, which are 16 hex digits
+bool is_entry_name(std::string_view name) {
+    return name.size() == 16 && std::all_of(name.begin(), name.end(), [](char c) {
+               return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+           });
+}
+
+// the pid in the name of the temporary file of an entry ("<entry>.tmp<pid>"), or 0 if
+// it isn't one
+pid_t temporary_owner(std::string_view name) {
+    if (name.size() <= 20 || !is_entry_name(name.substr(0, 16)) || name.substr(16, 4) != ".tmp") {
+        return 0;
+    }
+    pid_t pid = 0;
+    for (char c : name.substr(20)) {
+        if (c < '0' || c > '9' || pid > 100000000) {
+            return 0;
+        }
+        pid = pid * 10 + (c - '0');
+    }
+    return pid;
+}
+
+}  // namespace
+
+Cache::Cache(std::string_view stage, std::string_view source) {
+    const char* dir = std::getenv("CHAGALITE_CACHE_DIR");
+    uint64_t build = build_id();
+    if (!dir || !*dir || build == 0) {
+        return;
+    }
+
+    // the stage is last, so nothing can run together with it. std::hash is independent of
+    // FNV-1a, and only has to be stable within one build
+    key = std::format("chagalite-cache {} {:016x} {} {:016x} {}\n", VERSION, build, source.size(),
+                      static_cast<uint64_t>(std::hash<std::string_view>{}(source)), stage);
+    uint64_t h = fnv1a(key);
+    h = fnv1a(source, h);
+
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(h));
+
+    std::error_code ec;
+    directory = dir;
+    fs::create_directories(directory, ec);
+    if (!ec) {
+        path = directory / name;
+    }
+}
+
+bool Cache::lookup(std::string& output, int& status) {
+    if (!enabled()) {
+        return false;
+    }
+
+    // an entry that is removed while it is open can still be read to the end
+    std::ifstream entry(path, std::ios::binary);
+    std::string first;
+    if (!entry.is_open() || !std::getline(entry, first) || first + "\n" != key || !(entry >> status) ||
+        entry.get() != '\n') {
+        return false;
+    }
+
+    std::ostringstream contents;
+    contents << entry.rdbuf();
+    output = std::move(contents).str();
+
+    std::error_code ec;
+    fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+    return true;
+}
+
+void Cache::store(std::string_view output, int status) {
+    if (!enabled()) {
+        return;
+    }
+
+    // unique to this process, so concurrent stores never write the same file
+    fs::path temporary = path;
+    temporary += ".tmp" + std::to_string(::getpid());
+    {
+        std::ofstream entry(temporary, std::ios::binary | std::ios::trunc);
+        entry << key << status << "\n" << output;
+        if (!entry.flush()) {
+            std::error_code ec;
+            fs::remove(temporary, ec);
+            return;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(temporary, path, ec);
+    if (ec) {
+        fs::remove(temporary, ec);
+        return;
+    }
+    evict();
+}
+
+// removes the entries that were used the longest time ago until the rest fit. Only
+// files named like an entry are counted or removed, so pointing CHAGALITE_CACHE_DIR
+// at a directory that holds anything else can't delete it. Temporary files left by
+// writers that crashed are removed as well
+void Cache::evict() {
+    uintmax_t max_bytes = DEFAULT_MAX_BYTES;
+    if (const char* limit = std::getenv("CHAGALITE_CACHE_MAX_BYTES")) {
+        max_bytes = std::strtoull(limit, nullptr, 10);
+    }
+
+    struct Entry {
+        fs::file_time_type used;
+        uintmax_t size;
+        fs::path path;
+    };
+    std::vector<Entry> entries;
+    uintmax_t total = 0;
+
+    std::error_code ec;
+    for (const fs::directory_entry& file : fs::directory_iterator(directory, ec)) {
+        std::error_code file_ec;
+        std::string name = file.path().filename().string();
+        if (!file.is_regular_file(file_ec)) {
+            continue;
+        }
+        if (pid_t owner = temporary_owner(name)) {
+            // the writer renames it into place or removes it before it exits. Other
+            // machines sharing the directory have their own pids, so only a file that
+            // is also old enough counts as abandoned
+            fs::file_time_type written = file.last_write_time(file_ec);
+            if (!file_ec && ::kill(owner, 0) != 0 && errno == ESRCH &&
+                written < fs::file_time_type::clock::now() - STALE_TEMPORARY) {
+                fs::remove(file.path(), file_ec);
+            }
+            continue;
+        }
+        if (!is_entry_name(name)) {
+            continue;
+        }
+        Entry e = {file.last_write_time(file_ec), file.file_size(file_ec), file.path()};
+        if (!file_ec) {
+            total += e.size;
+            entries.push_back(std::move(e));
+        }
+    }
+    if (total <= max_bytes) {
+        return;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.used < b.used; });
+    for (const Entry& e : entries) {
+        if (total <= max_bytes) {
+            break;
+        }
+        // another process may have removed it already
+        fs::remove(e.path, ec);
+        total -= e.size;
+    }
+}
@@ -0,0 +1,107 @@
+/**
+ * @file cache.hpp
+ * @author Hartley Blakey
+ * @brief On-disk cache of the output of the stages, shared by every run of every stage
+ */
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include "writer.hpp"
+
+/**
+ * @brief The cached output of one stage for one source file, if caching is enabled.
+ *
+ * Caching is enabled by setting CHAGALITE_CACHE_DIR to a directory, which is created
+ * if needed. Each entry is a file named after a hash of its key, and holds the key,
+ * what the stage printed and its exit code. The key is the stage and its options, the
+ * cache version, the build of the program, and the size and a second, independent hash
+ * of the source. An entry is only used if its whole key matches, so the output of an
+ * older build, or of another source with the same file name hash, is never replayed.
+ *
+ * The build is identified by the size and modification time of the running executable,
+ * so rebuilding a stage after changing its output format starts over with new entries.
+ * If it can't be found, nothing is cached.
+ *
+ * Entries are written to a temporary file and renamed into place, so processes sharing
+ * the directory never see a partial entry. Once the entries in the directory take up
+ * more than CHAGALITE_CACHE_MAX_BYTES (or DEFAULT_MAX_BYTES), the least recently used
+ * ones are removed. Files that aren't named like an entry or its temporary file are
+ * never touched. Any failure to use the directory just means the entry is not cached.
+ */
+class Cache {
+   public:
+    /// @brief Change this whenever the layout of an entry changes
+    static constexpr std::string_view VERSION = "2";
+
+    static constexpr uintmax_t DEFAULT_MAX_BYTES = uintmax_t(256) << 20;
+
+    /// @brief The exit code of a parse that went over a ParseLimits limit, which is not
+    /// cached since running out of time depends on more than the input
+    static constexpr int LIMIT_STATUS = 6;
+
+    /// @brief How old the temporary file of a writer that no longer runs has to be
+    /// before it is removed
+    static constexpr std::chrono::minutes STALE_TEMPORARY{10};
+
+    /**
+     * @param stage The name of the stage, followed by any options that change its output
+     * @param source The contents of the input file
+     */
+    Cache(std::string_view stage, std::string_view source);
+
+    bool enabled() const { return !path.empty(); }
+
+    /**
+     * @brief Get the cached output of the stage, and mark the entry as recently used
+     *
+     * @return false if caching is disabled or there is no entry
+     */
+    bool lookup(std::string& output, int& status);
+
+    /**
+     * @brief Save the output of the stage, then evict old entries if the cache is full
+     */
+    void store(std::string_view output, int status);
+
+    /**
+     * @brief Write the cached output of the stage to out, or run the stage and cache
+     * what it wrote to out, unless it exited with LIMIT_STATUS
+     *
+     * @param stage Writes the output of the stage to out and returns its exit code
+     * @return The exit code of the stage
+     */
+    template <typename Stage>
+    int run(Writer& out, Stage&& stage) {
+        std::string output;
+        int status;
+        if (lookup(output, status)) {
+            out << output;
+            return status;
+        }
+
+        out.capture(enabled() ? &output : nullptr);
+        status = stage();
+        out.flush();
+        out.capture(nullptr);
+        if (status != LIMIT_STATUS) {
+            store(output, status);
+        }
+        return status;
+    }
+
+   private:
+    std::filesystem::path directory;
+    std::filesystem::path path;
+    std::string key;  // the first line of the entry
+
+    void evict();
+};
+
+#endif /* CACHE_HPP */
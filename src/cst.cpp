@@ -1,1017 +1,887 @@
 #include "cst.hpp"
 
-#include <iostream>
-
-
-
-#ifdef DEBUG
-#define DEBUG_PRINT(s) std::cout << s << " in " << __func__ << " seeing " << t.content << " --> " << tk->peek().content << " on line " << tk->getLine() << "\n";
-#else
-#define DEBUG_PRINT(s)
-#endif
-
-bool isBrace(Token t) {
-    return t.type == L_BRACE || t.type == R_BRACE;
-}
-
-bool Cst::is_relational_expression(Token t) {
-    return any(t, LT, GT, LT_EQUAL, GT_EQUAL, BOOLEAN_EQUAL, BOOLEAN_NOT_EQUAL);
+#include "parser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <utility>
+
+// the slot of each key goes in the first free one after hash, in a table that is
+// at most half full, so probes stay short
+template <typename Slot, typename Hash, typename IsEmpty>
+static void rehash(std::vector<Slot>& slots, Slot empty, Hash hash, IsEmpty is_empty) {
+    std::vector<Slot> old = std::exchange(slots, std::vector<Slot>(std::max<size_t>(64, 2 * slots.size()), empty));
+    size_t mask = slots.size() - 1;
+    for (const Slot& s : old) {
+        if (!is_empty(s)) {
+            size_t i = hash(s) & mask;
+            while (!is_empty(slots[i])) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = s;
+        }
+    }
 }
 
-bool Cst::is_numerical_operator(Token t) {
-    return any(t, PLUS, MINUS, ASTERISK, DIVIDE, MODULO, CARET);
+uint32_t SymbolTable::find_name(std::string_view name, size_t hash) const {
+    size_t mask = name_slots.size() - 1;
+    for (size_t i = hash & mask; !name_slots.empty() && name_slots[i] != EMPTY; i = (i + 1) & mask) {
+        uint32_t id = name_slots[i];
+        if (name_hashes[id] == hash && names[id] == name) {
+            return id;
+        }
+    }
+    return EMPTY;
 }
 
-bool Cst::is_boolean_operator(Token t) {
-    return any(t, BOOLEAN_AND, BOOLEAN_OR);
-}
+uint32_t SymbolTable::intern(std::string_view name) {
+    size_t hash = std::hash<std::string_view>{}(name);
+    uint32_t id = find_name(name, hash);
+    if (id != EMPTY) {
+        return id;
+    }
 
-bool Cst::is_boolean_literal(Token t) {
-    return t.type == IDENTIFIER && any(t, "TRUE", "FALSE");
+    if (2 * (names.size() + 1) > name_slots.size()) {
+        rehash(name_slots, EMPTY, [this](uint32_t id) { return name_hashes[id]; }, [](uint32_t id) { return id == EMPTY; });
+    }
+    size_t mask = name_slots.size() - 1;
+    size_t i = hash & mask;
+    while (name_slots[i] != EMPTY) {
+        i = (i + 1) & mask;
+    }
+    id = static_cast<uint32_t>(names.size());
+    name_slots[i] = id;
+    names.push_back(storage.emplace_back(name));
+    name_hashes.push_back(hash);
+    return id;
 }
 
-bool Cst::is_datatype_specifier(Token t) {
-    return t.type == IDENTIFIER && any(t, "char", "bool", "int");
+// the high bits of the product depend on every bit of the key, and are folded into
+// the low bits the mask keeps
+static size_t entry_hash(uint32_t scope, uint32_t name_id) {
+    uint64_t h = (uint64_t(scope) << 32 | name_id) * 0x9E3779B97F4A7C15;
+    return h ^ (h >> 32);
 }
 
-bool Cst::in_boolean_prefix() {
-    Token x = t.type == L_PAREN ? tk->peek() : t;
-    return is_boolean_literal(x) || x.type == BOOLEAN_NOT || is_boolean_operator(x);
+// the entry for the key, added empty if it isn't there
+SymbolTable::Entry& SymbolTable::entry(uint32_t scope, uint32_t name_id) {
+    if (2 * (used_entries + 1) > entries.size()) {
+        rehash(entries, Entry{}, [](const Entry& e) { return entry_hash(e.scope, e.name_id); },
+               [](const Entry& e) { return e.name_id == EMPTY; });
+    }
+    size_t mask = entries.size() - 1;
+    size_t i = entry_hash(scope, name_id) & mask;
+    for (; entries[i].name_id != EMPTY; i = (i + 1) & mask) {
+        if (entries[i].scope == scope && entries[i].name_id == name_id) {
+            return entries[i];
+        }
+    }
+    used_entries++;
+    entries[i] = {scope, name_id, NONE};
+    return entries[i];
 }
 
-bool Cst::not_reserved_word(Token t) {
-    return !any(t, is_boolean_literal, is_datatype_specifier, "procedure",
-                "function", "getchar", "printf", "sizeof", "return", "void",
-                "for", "while", "if");
+void SymbolTable::index(uint32_t symbol) {
+    Entry& e = entry(scopes[symbol], name_ids[symbol]);
+    shadowed[symbol] = e.symbol;
+    e.symbol = symbol;
 }
 
-// L_BRACE> <COMPOUND_STATEMENT> <R_BRACE> | <L_BRACE> <R_BRACE>
-bool Cst::parse_block() {
-    if (t.type != L_BRACE) {
-        return false;
+void SymbolTable::unindex(uint32_t symbol) {
+    uint32_t* link = &entry(scopes[symbol], name_ids[symbol]).symbol;
+    while (*link != symbol) {
+        link = &shadowed[*link];
     }
-    advance_child();
-
-    parse_compound();
-
-    expect_child(R_BRACE);
-
-    return true;
+    *link = shadowed[symbol];
 }
 
-/*
-return <EXPRESSION> <SEMICOLON>
-return <SINGLE_QUOTED_STRING> <SEMICOLON>
-return <DOUBLE_QUOTED_STRING> <SEMICOLON>
-*/
-bool Cst::parse_return() {
-    if (t.type != IDENTIFIER || t.content != "return") {
-        return false;
+uint32_t SymbolTable::lookup(uint32_t scope, std::string_view name) const {
+    uint32_t name_id = find_name(name, std::hash<std::string_view>{}(name));
+    if (name_id == EMPTY || entries.empty()) {
+        return NONE;
     }
-    advance_child();
-
-    if (!parse_expression()) {
-        if (t.type != SINGLE_QUOTE && t.type != DOUBLE_QUOTE) {
-            syntaxError("Functions can only return expressions or strings");
+    size_t mask = entries.size() - 1;
+    for (size_t i = entry_hash(scope, name_id) & mask; entries[i].name_id != EMPTY; i = (i + 1) & mask) {
+        if (entries[i].scope == scope && entries[i].name_id == name_id) {
+            return entries[i].symbol;
         }
-        TokenType quoteType = t.type;
-        advance_sibling();
-        expect_sibling(STRING);
-        expect_sibling(quoteType);
     }
-    expect_sibling(SEMICOLON);
-    return true;
+    return NONE;
 }
 
-bool Cst::parse_declaration() {
-    if (!is_datatype_specifier(t) || tk->peek().type != IDENTIFIER) {
-        return false;
-    }
-
-    table.add_var(tk->peek().content, to_datatype(t));
-
-    advance_child();  // data type
-    if (!parse_identifier_and_ident_arr_list()) {
-        syntaxError("empty declarations not allowed");
-    }
-    expect_sibling(SEMICOLON);
-
-    return true;
+uint32_t SymbolTable::add_symbol(std::string_view name, Kind kind, VariableType type) {
+    uint32_t symbol = static_cast<uint32_t>(name_ids.size());
+    name_ids.push_back(intern(name));
+    kinds.push_back(kind);
+    types.push_back(type);
+    scopes.push_back(current_scope());
+    first_params.push_back(0);
+    param_counts.push_back(0);
+    shadowed.push_back(NONE);
+    order.push_back(symbol);
+    index(symbol);
+    return symbol;
 }
 
-/*
-<IDENTIFIER> <L_PAREN> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN>
-<IDENTIFIER> <L_PAREN> <EXPRESSION> <R_PAREN>
-*/
-bool Cst::parse_call() {
-    if (t.type != IDENTIFIER || tk->peek().type != L_PAREN) {
-        return false;
+uint32_t SymbolTable::append(SymbolTable& other) {
+    uint32_t first = static_cast<uint32_t>(name_ids.size());
+    uint32_t first_param = static_cast<uint32_t>(params.size());
+    for (uint32_t p : other.params) {
+        params.push_back(first + p);
     }
-
-    advance_sibling();
-    advance_sibling();
-
-    if (!parse_identifier_and_ident_arr_param_list() && !parse_expression()) {
-        syntaxError("Expected param list or expression in function call");
+    for (uint32_t s = 0; s < other.name_ids.size(); s++) {
+        name_ids.push_back(intern(other.names[other.name_ids[s]]));
+        kinds.push_back(other.kinds[s]);
+        types.push_back(other.types[s]);
+        scopes.push_back(other.scopes[s]);
+        first_params.push_back(first_param + other.first_params[s]);
+        param_counts.push_back(other.param_counts[s]);
+        shadowed.push_back(NONE);
     }
-
-    expect_sibling(R_PAREN);
-
-    return true;
+    // in the order of the source, so the latest of two with the same key stays the latest
+    for (uint32_t s : other.order) {
+        index(first + s);
+    }
+    return first;
 }
 
-/*
-<IDENTIFIER> <L_PAREN> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN>
-<IDENTIFIER> <L_PAREN> <EXPRESSION> <R_PAREN>
-*/
-bool Cst::parse_call_statement() {
-    if (t.type != IDENTIFIER || tk->peek().type != L_PAREN) {
-        return false;
+void SymbolTable::replace(size_t position, size_t count, SymbolTable& other) {
+    for (size_t i = position; i < position + count; i++) {
+        unindex(order[i]);
     }
-    advance_child();
-    advance_sibling();
-    parse_identifier_and_ident_arr_param_list() || parse_expression();
-    expect_sibling(R_PAREN);
-    expect_sibling(SEMICOLON);
-    return true;
+    uint32_t first = append(other);
+    std::vector<uint32_t> moved;
+    for (uint32_t s : other.order) {
+        moved.push_back(first + s);
+    }
+    order.erase(order.begin() + position, order.begin() + position + count);
+    order.insert(order.begin() + position, moved.begin(), moved.end());
+    other = SymbolTable();
 }
 
-bool Cst::parse_sizeof() {
-    if (t.type != IDENTIFIER || t.content != "sizeof") {
-        return false;
+void SymbolTable::splice(std::span<const std::pair<uint32_t, SymbolTable*>> parts) {
+    if (parts.empty()) {
+        return;
     }
-    advance_child();
-    expect_sibling(L_PAREN);
-    expect_sibling(IDENTIFIER);
-    expect_sibling(R_PAREN);
-    return true;
+    std::vector<uint32_t> spliced;
+    spliced.reserve(order.size());
+    size_t next = 0;
+    for (uint32_t s : order) {
+        spliced.push_back(s);
+        for (; next < parts.size() && parts[next].first == s; next++) {
+            SymbolTable& other = *parts[next].second;
+            uint32_t first = append(other);
+            for (uint32_t o : other.order) {
+                spliced.push_back(first + o);
+            }
+            other = SymbolTable();
+        }
+    }
+    assert(next == parts.size());
+    order = std::move(spliced);
 }
 
-bool Cst::parse_getchar() {
-    if (t.type != IDENTIFIER || t.content != "getchar") {
-        return false;
+void SymbolTable::print(Writer& out) const {
+    for (uint32_t s : order) {
+        printSymbol(out, scopes[s], getName(s), kinds[s], types[s], param_counts[s],
+                    [&](uint32_t i) { return types[params[first_params[s] + i]]; });
     }
-    advance_child();
-    expect_sibling(L_PAREN);
-    expect("void", "getchar must be called with argument 'void'");
-    expect_sibling(IDENTIFIER);
-    expect_sibling(R_PAREN);
-    return true;
 }
 
-/*
-printf <L_PAREN> <DOUBLE_QUOTED_STRING> <R_PAREN> <SEMICOLON>
-printf <L_PAREN> <SINGLE_QUOTED_STRING> <R_PAREN> <SEMICOLON>
-printf <L_PAREN> <DOUBLE_QUOTED_STRING> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN> <SEMICOLON>
-printf <L_PAREN> <SINGLE_QUOTED_STRING> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN> <SEMICOLON>
-*/
-bool Cst::parse_printf() {
-    if (t.type != IDENTIFIER || t.content != "printf") {
-        return false;
-    }
+// fills in the symbol table of a Cst from the declarations the parser reports
+struct Cst::TableBuilder : ParseHandler {
+    SymbolTable& table;
 
-    advance_child();  // printf
-    expect_sibling(L_PAREN);
+    TableBuilder(SymbolTable& table) : table(table) {}
 
-    if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == STRING) {
-        auto quoteType = t.type;
-        advance_sibling();          // quote
-        advance_sibling();          // string
-        expect_sibling(quoteType);  // end quote
-    } else {
-        syntaxError("printf statement must have a format string");
+    void enter_function(std::string_view name, std::optional<Datatype> return_type) {
+        table.enter_function(name, return_type);
     }
 
-    if (t.type == COMMA) {
-        advance_sibling();
-        parse_identifier_and_ident_arr_param_list();
+    void add_param(std::string_view name, Datatype type) {
+        table.add_param(name, type);
     }
 
-    expect_sibling(R_PAREN);
-    expect_sibling(SEMICOLON);
-
-    return true;
-}
+    void add_var(std::string_view name, Datatype type) {
+        table.add_var(name, type);
+    }
 
-bool Cst::parse_assignment() {
-    if (t.type != IDENTIFIER || is_datatype_specifier(t)) {
-        return false;
+    void exit_function() {
+        table.exit_function();
     }
+};
 
-    expect(not_reserved_word, "Cannot assign to reserved word {}", t.content);
-    advance_child();
+struct Cst::TreeBuilder : TableBuilder {
+    NodeArena& arena;
+    CstNode* current;
 
-    if (t.type == L_BRACKET) {
-        advance_sibling();
+    // if set, the tokens of each outermost expression rule are collected, and turned
+    // into an expression tree once the rule is done
+    Expressions* exprs = nullptr;
+    std::vector<Token> expr_tokens;
+    CstNode* expr_start = nullptr;
+    unsigned expr_depth = 0;
+    size_t max_depth = ParseLimits::DEFAULT_MAX_DEPTH;
+    bool expr_too_deep = false;
 
-        if (!parse_numerical_expression()) {
-            syntaxError("Invalid array index");
-        }
-        expect_sibling(R_BRACKET);
-    }
-
-    expect_sibling(ASSIGNMENT_OPERATOR);
-    if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == STRING) {
-        auto quoteType = t.type;
-        advance_sibling();          // quote
-        advance_sibling();          // string
-        expect_sibling(quoteType);  // end quote
-    } else if (parse_expression()) {
-        // already done here
-    } else if (t.type == IDENTIFIER) {
-        expect(not_reserved_word, "attempted to take value of reserved word {}", t.content);
-        advance_sibling();
-    } else if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == ESCAPED_CHARACTER) {
-        auto quoteType = t.type;
-        advance_sibling();          // quote
-        advance_sibling();          // escaped char
-        expect_sibling(quoteType);  // end quote
-    } else {
-        syntaxError("invalid assignment");
-    }
-
-    expect_sibling(SEMICOLON);
+    // if set, every rule and node is also kept in order, see CstOptions::rules
+    std::vector<RuleEvent>* rules = nullptr;
 
-    return true;
-}
+    TreeBuilder(SymbolTable& table, NodeArena& arena, CstNode* root) : TableBuilder(table), arena(arena), current(root) {}
 
-/*
-for     <L_PAREN> <INITIALIZATION_EXPRESSION> <SEMICOLON> <BOOLEAN_EXPRESSION> <SEMICOLON> <ITERATION_ASSIGNMENT> <R_PAREN> <STATEMENT>
-for     <L_PAREN> <INITIALIZATION_EXPRESSION> <SEMICOLON> <BOOLEAN_EXPRESSION> <SEMICOLON> <ITERATION_ASSIGNMENT> <R_PAREN> <BLOCK_STATEMENT>
-while   <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT>
-while   <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT>
-*/
-bool Cst::parse_iteration() {
-    if (t.type != IDENTIFIER) {
-        return false;
+    void enter(Rule r) {
+        if (rules) {
+            rules->push_back({RuleEvent::Enter, r, nullptr});
+        }
+        if (exprs && is_expression(r)) {
+            expr_depth++;
+        }
     }
 
-    if (t.content == "for") {
-        advance_child();
-        expect_sibling(L_PAREN);
-        parse_initialization();
-        expect_sibling(SEMICOLON);
-        if (!parse_boolean_expression()) {
-            syntaxError("Expected boolean expression in for loop condition");
+    void exit(Rule r) {
+        if (rules) {
+            rules->push_back({RuleEvent::Exit, r, nullptr});
         }
-        expect_sibling(SEMICOLON);
-        parse_iteration_assignment();
-        expect_sibling(R_PAREN);
-        if (!parse_block() && !parse_statement()) {
-            syntaxError("Expected expression or block after for loop");
+        if (!exprs || !is_expression(r) || --expr_depth > 0 || expr_tokens.empty()) {
+            return;
         }
-    } else if (t.content == "while") {
-        advance_child();
-        expect_sibling(L_PAREN);
-        parse_boolean_expression();
-        expect_sibling(R_PAREN);
-        if (!parse_block() && !parse_statement()) {
-            syntaxError("Expected expression or block after while loop");
+        uint32_t root = exprs->pool.parse(expr_tokens, max_depth);
+        if (root == ExprPool::TOO_DEEP) {
+            expr_too_deep = true;
+        } else if (root != ExprPool::NONE) {
+            exprs->roots[expr_start] = root;
         }
-    } else {
-        return false;
-    }
-
-    return true;
-}
-
-/*
-if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT> |
-if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT> |
-
-if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT> else <STATEMENT> |
-if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT> else <BLOCK_STATEMENT>
-
-if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT> else <STATEMENT> |
-if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT> else <BLOCK_STATEMENT> |
-
-*/
-bool Cst::parse_selection() {
-    if (t.type != IDENTIFIER || t.content != "if") {
-        return false;
+        expr_tokens.clear();
     }
 
-    advance_child();
-    expect_sibling(L_PAREN);
+    bool too_deep() const { return expr_too_deep; }
 
-    if (!parse_boolean_expression()) {
-        syntaxError("Expected boolean expression in 'if' statement");
+    void child(const Token& t) {
+        current->child = arena.make(t);
+        current = current->child;
+        record(t);
     }
 
-    expect_sibling(R_PAREN);
-
-    if (!parse_block() && !parse_statement()) {
-        syntaxError("Expected statement in 'if' block");
+    void sibling(const Token& t) {
+        current->sib = arena.make(t);
+        current = current->sib;
+        record(t);
     }
 
-    if (t.type != IDENTIFIER || t.content != "else") {
-        return true;
+    void record(const Token& t) {
+        if (rules) {
+            rules->push_back({RuleEvent::Node, Rule::Program, current});
+        }
+        if (expr_depth > 0) {
+            if (expr_tokens.empty()) {
+                expr_start = current;
+            }
+            expr_tokens.push_back(t);
+        }
     }
 
-    advance_child();  // else
-
-    if (!parse_block() && !parse_statement()) {
-        syntaxError("Expected statement in 'else' block");
+    // operands and relational operators only appear inside of these
+    static bool is_expression(Rule r) {
+        return r == Rule::Expression || r == Rule::BooleanExpression || r == Rule::NumericalExpression;
     }
+};
 
-    return true;
-}
+// writes every token in the format of Cst::print() instead of keeping it
+struct Cst::TreeStreamer : TableBuilder {
+    Writer& sink;
+    bool streamed = false;
 
-/*
-<IDENTIFIER> <ASSIGNMENT_OPERATOR> <EXPRESSION>
-<IDENTIFIER> <ASSIGNMENT_OPERATOR> <SINGLE_QUOTED_STRING>
-<IDENTIFIER> <ASSIGNMENT_OPERATOR> <DOUBLE_QUOTED_STRING>
-*/
-bool Cst::parse_iteration_assignment() {
-    return parse_initialization();
-}
+    TreeStreamer(SymbolTable& table, Writer& sink) : TableBuilder(table), sink(sink) {}
 
-/*
-<IDENTIFIER> <ASSIGNMENT_OPERATOR> <EXPRESSION>
-<IDENTIFIER> <ASSIGNMENT_OPERATOR> <SINGLE_QUOTED_STRING>
-<IDENTIFIER> <ASSIGNMENT_OPERATOR> <DOUBLE_QUOTED_STRING>
-*/
-bool Cst::parse_initialization() {
-    if (t.type != IDENTIFIER || tk->peek().type != ASSIGNMENT_OPERATOR) {
-        return false;
+    void child(const Token& t) {
+        stream("\n", t);
     }
 
-    advance_sibling();
-    advance_sibling();
+    void sibling(const Token& t) {
+        stream("   ", t);
+    }
 
-    if (!parse_expression()) {
-        if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == STRING) {
-            TokenType quoteType = t.type;
-            advance_sibling();          // quote
-            advance_sibling();          // string
-            expect_sibling(quoteType);  // end quote
-        } else {
-            syntaxError("iteration assignment value must be string or expression");
+    // the separator ends the line of the previously written node
+    void stream(std::string_view separator, const Token& t) {
+        if (streamed) {
+            sink << separator;
         }
+        sink << t.content;
+        streamed = true;
     }
+};
 
-    return true;
-}
+struct Cst::DeclarationScanner : TableBuilder {
+    static constexpr bool skim_bodies = true;
 
-bool Cst::parse_expression() {
-    // we need to strip the parenthesis since (x + y) and (x + y < 4) dead end
-    //     if you try to parse the first as boolean or the second as numeric
-    bool parenthesised = false;
-    if (t.type == L_PAREN) {
-        parenthesised = true;
-        advance_sibling();  // '('
-    }
+    DeclarationScanner(SymbolTable& table) : TableBuilder(table) {}
+};
 
-    // potential shared prefix
-    if (parse_numerical_expression()) {
-        if (parenthesised && t.type == R_PAREN) {
-            advance_sibling();
-            parenthesised = false;
-        }
-        if (parse_relational_expression()) {
-            if (!parse_numerical_expression()) {
-                syntaxError("Expected numerical expression on rhs of relational operator");
-            }
-            if (parenthesised && t.type == R_PAREN) {
-                advance_sibling();
-                parenthesised = false;
-            }
-            // <num expr> <rel op> <num expr>
-            if (is_boolean_operator(t)) {
-                if (!parse_boolean_expression()) {
-                    syntaxError("Expected boolean expression after boolean operator");
-                }
-                // <num expr> <rel op> <num expr> <bool op> <bool expr>
-            }
-        }
-        if (parenthesised) {
-            expect_sibling(R_PAREN);
-        }
-    } else {
-        if (!parenthesised) {
-            return parse_boolean_expression();
-        }
-        if (!parse_boolean_expression()) {
-            syntaxError("Expected expression in parenthesis");
-        }
-        expect_sibling(R_PAREN);
+struct Cst::LazyTreeBuilder : TreeBuilder {
+    static constexpr bool lazy_bodies = true;
 
-        if (is_boolean_operator(t)) {
-            advance_sibling();
-            if (!parse_boolean_expression()) {
-                syntaxError("Expected boolean expression after boolean operator");
-            }
+    Cst* cst;
+    CstNode* definition = nullptr;
+
+    LazyTreeBuilder(Cst* cst) : TreeBuilder(cst->table, cst->arenas[0], cst->root), cst(cst) {
+        max_depth = cst->limits.max_depth;
+        if (cst->build_expressions) {
+            exprs = &cst->exprs;
         }
     }
 
-    return true;
-}
-
-/*
-                        <NUMERICAL_OPERAND> |
-<L_PAREN> 				<NUMERICAL_OPERAND> 	<R_PAREN> |
-                        <NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> |
-<L_PAREN> 				<NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> <R_PAREN> |
-                        <NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	<L_PAREN> 		<NUMERICAL_EXPRESSION> <R_PAREN> <NUMERICAL_OPERATOR> <NUMERICAL_EXPRESSION> |
-<L_PAREN> 				<NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> <R_PAREN> |
-                        <NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	<L_PAREN> 		<NUMERICAL_EXPRESSION> <R_PAREN> |
-<L_PAREN> 				<NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> <R_PAREN> <NUMERICAL_OPERATOR> <NUMERICAL_EXPRESSION> |
-                        <NUMERICAL_OPERATOR> 	<NUMERICAL_EXPRESSION>
-*/
-bool Cst::parse_numerical_expression() {
-    if (in_boolean_prefix()) {
-        return false;
+    void enter_function(std::string_view name, std::optional<Datatype> return_type) {
+        TreeBuilder::enter_function(name, return_type);
+        definition = current;
     }
 
-    if (is_numerical_operator(t)) {
-        advance_sibling();
-        if (!parse_numerical_expression()) {
-            syntaxError("Expected numerical expression after numerical operator");
-        }
-    } else {
-        bool expecting_parenthesis = false;
-        if (t.type == L_PAREN) {
-            expecting_parenthesis = true;
-            advance_sibling();
-        }
+    void deferred_body(const Token& open, size_t line) {
+        size_t offset = open.content.data() - cst->source.data() + 1;
+        cst->lazy.push_back({definition, current, nullptr, table.current_function, table.getSymbols().back(), offset, line, false, {}, {}, {}, {}});
+    }
 
-        if (!parse_numerical_operand()) {
-            if (expecting_parenthesis) {
-                syntaxError("Expected numerical operand in numerical expression");
-            } else {
-                return false;
-            }
+    void child(const Token& t) {
+        TreeBuilder::child(t);
+        // the closing brace of a deferred body
+        if (!cst->lazy.empty() && !cst->lazy.back().close) {
+            cst->lazy.back().close = current;
         }
+    }
+};
 
-        if (t.type == R_PAREN) {
-            if (!expecting_parenthesis) {
-                return true;
-            }
-            expecting_parenthesis = false;
-            advance_sibling();
-
-        } else {
-            if (!is_numerical_operator(t)) {
-                if (expecting_parenthesis) {
-                    syntaxError("failed to find closing parenthesis in numerical expression");
-                }
-                // just a single operand
-                return true;
-            }
-
-            advance_sibling();
-
-            if (t.type == L_PAREN) {
-                if (expecting_parenthesis) {
-                    syntaxError("Unexpected L_PAREN");
-                }
-                expecting_parenthesis = true;
-                advance_sibling();
-            }
-
-            if (!parse_numerical_expression()) {
-                syntaxError("Expected numerical expression");
-            }
-
-            if (expecting_parenthesis) {
-                expect_sibling(R_PAREN);
-                expecting_parenthesis = false;
-            }
+// also records where each top level definition starts and ends, see Cst::edit()
+struct Cst::DefinitionTracker : TreeBuilder {
+    Cst* cst;
 
-            if (is_numerical_operator(t)) {
-                advance_sibling();
+    // how many definitions are open, counting declarations inside of functions
+    unsigned nesting = 0;
+    CstNode* before = nullptr;
+    size_t first_symbol = 0;
+    uint32_t scope = 0;
 
-                if (!parse_numerical_expression()) {
-                    syntaxError("Expected numerical expression");
-                }
-            }
+    DefinitionTracker(Cst* cst) : TreeBuilder(cst->table, cst->arenas[0], cst->root), cst(cst) {
+        max_depth = cst->limits.max_depth;
+        if (cst->build_expressions) {
+            exprs = &cst->exprs;
         }
+    }
 
-        if (expecting_parenthesis) {
-            expect_sibling(R_PAREN);
-            expecting_parenthesis = false;
+    void enter(Rule r) {
+        TreeBuilder::enter(r);
+        if (is_definition(r) && nesting++ == 0) {
+            before = current;
+            first_symbol = table.getSymbols().size();
+            scope = table.next_scope;
         }
     }
 
-    return true;
-}
+    void exit(Rule r) {
+        TreeBuilder::exit(r);
+        if (!is_definition(r) || --nesting > 0 || !before->child) {
+            return;
+        }
 
-/*
-<BOOLEAN_TRUE> | <BOOLEAN_FALSE> | <IDENTIFIER> |
-<IDENTIFIER> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
-<BOOLEAN_NOT> <BOOLEAN_TRUE> |
-<BOOLEAN_NOT> <BOOLEAN_FALSE> |
-<BOOLEAN_NOT> <IDENTIFIER> |
-<USER_DEFINED_FUNCTION> |
-<USER_DEFINED_FUNCTION> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
-<BOOLEAN_NOT> <USER_DEFINED_FUNCTION> |
-<L_PAREN> <USER_DEFINED_FUNCTION> <R_PAREN> |
-<L_PAREN> <IDENTIFIER> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> <R_PAREN> |
-<NUMERICAL_EXPRESSION> <RELATIONAL_EXPRESSION> <NUMERICAL_EXPRESSION> |
-<L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN> |
-<L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
-<L_PAREN> <BOOLEAN_NOT> <IDENTIFIER> <R_PAREN> |
-<L_PAREN> <BOOLEAN_NOT> <IDENTIFIER> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> <R_PAREN> |
-<L_PAREN> <BOOLEAN_NOT> <USER_DEFINED_FUNCTION> <R_PAREN> |
-<L_PAREN> <BOOLEAN_NOT> <USER_DEFINED_FUNCTION> <R_PAREN> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
-<L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_EXPRESSION> <R_PAREN>
-*/
-bool Cst::parse_boolean_expression() {
-    bool parenthesized = false;
-
-    if (t.type == INTEGER && !is_relational_expression(tk->peek())) {
-        return false;
+        std::string_view first = before->child->t.content;
+        std::string_view last = current->t.content;
+        cst->definitions.push_back({
+            before->child,
+            current,
+            first_symbol,
+            table.getSymbols().size() - first_symbol,
+            scope,
+            r == Rule::Declaration,
+            size_t(first.data() - cst->source.data()),
+            size_t(last.data() + last.size() - first.data()),
+            0,
+            nullptr,
+        });
     }
 
-    if (t.type == L_PAREN && tk->peek().type == IDENTIFIER) {
-        parenthesized = true;
-        advance_sibling();
-
-        if (is_boolean_operator(tk->peek())) {
-            advance_sibling();
-            parse_boolean_expression();
-            expect_sibling(R_PAREN);
-            return true;
-        } else if (parse_call()) {
-            expect_sibling(R_PAREN);
-            return true;
-        }
+    static bool is_definition(Rule r) {
+        return r == Rule::Main || r == Rule::Function || r == Rule::Procedure || r == Rule::Declaration;
     }
+};
 
-    if (parenthesized && t.type == IDENTIFIER && is_relational_expression(tk->peek())) {
-        // parse as
-        // <L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN>
-        // <L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION>
-
-        parse_numerical_operand();
-        parse_relational_expression();
-        parse_numerical_operand();
-
-        expect_sibling(R_PAREN);
-
-        if (is_boolean_operator(t)) {
-            advance_sibling();
-            parse_boolean_expression();
+ParseLimits ParseLimits::fromEnvironment() {
+    ParseLimits limits;
+    auto read = [](const char* name, size_t& limit) {
+        const char* value = std::getenv(name);
+        if (value && *value) {
+            limit = std::strtoull(value, nullptr, 10);
         }
+    };
+    read("CHAGALITE_MAX_NODES", limits.max_nodes);
+    read("CHAGALITE_MAX_BYTES", limits.max_bytes);
+    read("CHAGALITE_MAX_DEPTH", limits.max_depth);
 
-        return true;
+    size_t timeout = 0;
+    read("CHAGALITE_TIMEOUT_MS", timeout);
+    if (timeout) {
+        limits.deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
     }
+    return limits;
+}
 
-    if (parse_numerical_expression()) {
-        if (parenthesized && t.type == R_PAREN) {
-            advance_sibling();
-            parenthesized = false;
-        }
-        expect(is_relational_expression, "Expected relational operator after numerical expression, found {}", t.content);
-        advance_sibling();
-        if (!parse_numerical_expression()) {
-            syntaxError("Expected numerical expression after relational operator");
-        }
-        if (parenthesized) {
-            expect_sibling(R_PAREN);
-        }
-        return true;
+std::string ParseLimits::describe() const {
+    std::string limits;
+    if (max_nodes != SIZE_MAX) {
+        limits += " max_nodes=" + std::to_string(max_nodes);
     }
-
-    if (t.type == L_PAREN) {
-        parenthesized = true;
-        advance_sibling();
+    if (max_bytes != SIZE_MAX) {
+        limits += " max_bytes=" + std::to_string(max_bytes);
     }
-
-    if (t.type == BOOLEAN_NOT) {
-        advance_sibling();
+    if (max_depth != DEFAULT_MAX_DEPTH) {
+        limits += " max_depth=" + std::to_string(max_depth);
     }
+    return limits;
+}
 
-    if (is_boolean_literal(t)) {
-        advance_sibling();
-        if (parenthesized) {
-            expect_sibling(R_PAREN);
-        }
+// only the limits, syntax errors are kept in the error itself
+static ParseStatus limit_hit(ParseStatus status) {
+    return status == ParseStatus::SyntaxError ? ParseStatus::Ok : status;
+}
 
-        return true;
+ParseStatus Cst::getStatus() {
+    if (limit != ParseStatus::Ok) {
+        return limit;
     }
+    return ok() ? ParseStatus::Ok : ParseStatus::SyntaxError;
+}
 
-    if (parse_call()) {
-        if (parenthesized) {
-            expect_sibling(R_PAREN);
-        }
-
-        if (is_boolean_operator(t)) {
-            advance_sibling();
-            if (!parse_boolean_expression()) {
-                syntaxError("Expected boolean expression");
-            }
-        }
+void Cst::build(Tokenizer* tk, CstOptions options) {
+    source = tk->getSource();
+    limits = options.limits;
+    build_expressions = options.expressions;
 
-        return true;
+    if (options.declarations_only) {
+        DeclarationScanner scanner(table);
+        Parser<DeclarationScanner> parser(tk, scanner, limits);
+        parser.parse();
+        error = parser.getError();
+        diagnostics = parser.getDiagnostics();
+        limit = limit_hit(parser.getStatus());
+        return;
     }
 
-    if (t.type == IDENTIFIER) {
-        advance_sibling();
-
-        if (is_boolean_operator(t)) {
-            advance_sibling();
-
-            if (!parse_boolean_expression()) {
-                syntaxError("Expected boolean expression");
-            }
-        }
+    if (!options.sink && (options.lazy_bodies || options.threads)) {
+        LazyTreeBuilder builder(this);
+        Parser<LazyTreeBuilder> parser(tk, builder, limits);
+        parser.parse();
+        error = parser.getError();
+        diagnostics = parser.getDiagnostics();
+        limit = limit_hit(parser.getStatus());
 
-        if (parenthesized) {
-            expect_sibling(R_PAREN);
+        if (options.threads) {
+            expand_parallel(options.threads);
         }
-
-        return true;
+        return;
     }
 
-    if (parenthesized && parse_numerical_operand()) {
-        expect(is_relational_expression, "Expected relational operator after numerical operand, found {}", t.content);
-        advance_sibling();
-
-        if (parse_numerical_operand()) {
-            expect_sibling(R_PAREN);
+    if (!options.sink && options.incremental) {
+        // the tokens of definitions that are never edited keep pointing into the copy
+        text = std::make_unique<std::string>(source);
+        source = *text;
+        Tokenizer copy(source);
 
-            // <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION>
-            if (is_boolean_operator(t)) {
-                advance_sibling();
+        DefinitionTracker builder(this);
+        Parser<DefinitionTracker> parser(&copy, builder, limits);
+        parser.parse();
+        error = parser.getError();
+        diagnostics = parser.getDiagnostics();
+        limit = limit_hit(parser.getStatus());
 
-                if (!parse_boolean_expression()) {
-                    syntaxError("expected boolean expression after boolean operator");
-                }
-            }
-
-        } else if (parse_numerical_expression()) {
-            expect_sibling(R_PAREN);
-        } else {
-            syntaxError("Expected numerical value after numerical operand + relational expression");
+        size_t line = 1;
+        size_t counted = 0;
+        for (Definition& d : definitions) {
+            line += std::count(source.begin() + counted, source.begin() + d.offset, '\n');
+            counted = d.offset;
+            d.line = line;
         }
-
-        return true;
+        return;
     }
 
-    return false;
-}
+    if (!options.sink) {
+        TreeBuilder builder(table, arenas[0], root);
+        builder.max_depth = limits.max_depth;
+        if (build_expressions) {
+            builder.exprs = &exprs;
+        }
+        if (options.rules) {
+            builder.rules = &rules;
+        }
+        Parser<TreeBuilder> parser(tk, builder, limits);
+        parser.parse();
+        error = parser.getError();
+        diagnostics = parser.getDiagnostics();
+        limit = limit_hit(parser.getStatus());
+        return;
+    }
 
-bool Cst::parse_relational_expression() {
-    if (is_relational_expression(t)) {
-        advance_sibling();
-        return true;
+    TreeStreamer streamer(table, *options.sink);
+    Parser<TreeStreamer> parser(tk, streamer, limits);
+    if (parser.parse()) {
+        // end the last line, or match print() on an empty tree
+        *options.sink << (streamer.streamed ? "\n" : "NULL NODE POINTER!!");
     }
-    return false;
+    error = parser.getError();
+    diagnostics = parser.getDiagnostics();
+    limit = limit_hit(parser.getStatus());
 }
 
-/*
-<IDENTIFIER> |
-<INTEGER> |
-<IDENTIFIER> <L_BRACKET> <NUMERICAL EXPRESSION> <R_BRACKET> |
-<GETCHAR_FUNCTION> |
-<USER_DEFINED_FUNCTION> |
-<SINGLE_QUOTE> <CHARACTER> <SINGLE_QUOTE> |
-<SINGLE_QUOTE> <ESCAPED_CHARACTER> <SINGLE_QUOTE> |
-<DOUBLE_QUOTE> <CHARACTER> <DOUBLE_QUOTE> |
-<DOUBLE_QUOTE> <ESCAPED_CHARACTER> <DOUBLE_QUOTE> |
-<SIZEOF_FUNCTION>
-*/
-bool Cst::parse_numerical_operand() {
-    bool basic = parse_first_accepted({&Cst::parse_getchar,
-                                       &Cst::parse_sizeof,
-                                       &Cst::parse_call});
+// only touches the nodes between the braces of the body, and the body's own symbol
+// table, so different bodies can be parsed at the same time
+void Cst::parse_body(LazyBody& body, NodeArena& arena) {
+    // the statements go between the braces, as if the body had been parsed right away
+    body.open->child = nullptr;
+    body.symbols.resume_function(table.getScope(body.function));
 
-    if (basic) {
-        return true;
+    Tokenizer tk(source, body.offset, body.line);
+    TreeBuilder builder(body.symbols, arena, body.open);
+    builder.max_depth = limits.max_depth;
+    if (build_expressions) {
+        builder.exprs = &body.exprs;
     }
+    Parser<TreeBuilder> parser(&tk, builder, limits);
+    parser.parseBody();
+    builder.current->child = body.close;
 
-    if (is_boolean_literal(t)) {
-        return false;
+    body.symbols.exit_function();
+    body.error = parser.getError();
+    body.diagnostics = parser.getDiagnostics();
+    body.limit = limit_hit(parser.getStatus());
+    body.parsed = true;
+}
+
+// puts the variables of parsed bodies where an eager parse would have put them,
+// with one pass over the table. The bodies must be in the order of the source
+void Cst::merge(std::span<LazyBody* const> bodies) {
+    std::vector<std::pair<uint32_t, SymbolTable*>> parts;
+    for (LazyBody* body : bodies) {
+        parts.emplace_back(body->last_symbol, &body->symbols);
     }
+    table.splice(parts);
 
-    if (any(t, INTEGER, IDENTIFIER)) {
-        advance_sibling();
-        if (t.type == L_BRACKET) {
-            advance_sibling();
-            if (!parse_numerical_expression()) {
-                syntaxError("invalid array index");
-            }
-            expect_sibling(R_BRACKET);
+    for (LazyBody* body : bodies) {
+        exprs.append(body->exprs);
+        body->exprs = {};
+        if (ok()) {
+            error = body->error;
         }
-        return true;
-    } else if (any(t, SINGLE_QUOTE, DOUBLE_QUOTE)) {
-        TokenType quote_type = t.type;
-
-        advance_sibling();
-
-        if (!any(t, ESCAPED_CHARACTER, CHARACTER)) {
-            if (t.type == END) {
-                syntaxError("unterminated string quote.");
-            } else {
-                syntaxError("expected character or escaped character in quotes");
-            }
+        if (limit == ParseStatus::Ok) {
+            limit = body->limit;
         }
-
-        advance_sibling();
-
-        expect_sibling(quote_type);
-        return true;
     }
-
-    return false;
 }
 
-/*
-<IDENTIFIER>
-<IDENTIFIER> <L_BRACKET> <IDENTIFIER> <R_BRACKET>
-<IDENTIFIER> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST>
-<IDENTIFIER> <L_BRACKET> <IDENTIFIER> <R_BRACKET> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST>
-<IDENTIFIER> <L_BRACKET> <NUMERICAL_EXPRESSION> <R_BRACKET>
-<IDENTIFIER> <L_BRACKET> <NUMERICAL_EXPRESSION> <R_BRACKET> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST>
-*/
-bool Cst::parse_identifier_and_ident_arr_param_list() {
-    if (t.type != IDENTIFIER) {
-        return false;
+void Cst::expand(LazyBody& body) {
+    if (body.parsed) {
+        return;
     }
-    advance_sibling();
+    parse_body(body, arenas[0]);
+    LazyBody* parsed[] = {&body};
+    merge(parsed);
+    first_body_error();
+}
 
-    if (t.type == L_BRACKET) {
-        advance_sibling();  // l bracket
-        if (t.type == IDENTIFIER) {
-            advance_sibling();  // ident
-        } else if (!parse_numerical_expression()) {
-            syntaxError("Invalid array index in parameter list");
-        }
-        expect_sibling(R_BRACKET);
+// deferring stops at the first error of the top level parse, so every deferred body
+// comes before all of its errors
+std::vector<Diagnostic> Cst::getDiagnostics() {
+    std::vector<Diagnostic> all;
+    for (LazyBody& body : lazy) {
+        all.insert(all.end(), body.diagnostics.begin(), body.diagnostics.end());
     }
+    all.insert(all.end(), diagnostics.begin(), diagnostics.end());
+    return all;
+}
 
-    if (t.type != COMMA) {
-        return true;
+// the top level parse stops deferring bodies at its first error, so an error in any
+// of them comes first in the file
+void Cst::first_body_error() {
+    for (LazyBody& body : lazy) {
+        if (!body.error.empty()) {
+            error = body.error;
+            return;
+        }
     }
+}
 
-    advance_sibling();  // comma
-
-    parse_identifier_and_ident_arr_param_list();
+void Cst::expand_parallel(unsigned threads) {
+    threads = std::min<size_t>(threads, lazy.size());
 
-    return true;
-}
+    // made before any worker starts, so the vector never reallocates under them
+    size_t first_arena = arenas.size();
+    arenas.resize(first_arena + threads);
 
-bool Cst::parse_identifier_and_ident_arr_list() {
-    if (t.type != IDENTIFIER) {
-        return false;
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < threads; w++) {
+        workers.emplace_back([this, &next, &arena = arenas[first_arena + w]] {
+            for (size_t i = next++; i < lazy.size(); i = next++) {
+                parse_body(lazy[i], arena);
+            }
+        });
     }
-    expect(not_reserved_word, "reserved word \"{}\" cannot be used for the name of a variable.", t.content);
-    advance_sibling();  // ident
-    if (t.type == L_BRACKET) {
-        advance_sibling();
-        if (!t.content.empty() && t.content[0] == '-') {
-            syntaxError("array declaration size must be a positive integer.");
-        }
-        expect_sibling(INTEGER);
-        expect_sibling(R_BRACKET);
+    for (std::thread& worker : workers) {
+        worker.join();
     }
 
-    if (t.type == COMMA) {
-        advance_sibling();
-        parse_identifier_and_ident_arr_list();
+    // in source order, so the table is the same whatever order the bodies finished in
+    std::vector<LazyBody*> parsed;
+    for (LazyBody& body : lazy) {
+        parsed.push_back(&body);
     }
-
-    return true;
+    merge(parsed);
+    first_body_error();
 }
 
-bool Cst::parse_statement() {
-    return parse_first_accepted({
-        &Cst::parse_declaration,
-        &Cst::parse_printf,
-        &Cst::parse_selection,
-        &Cst::parse_iteration,
-        &Cst::parse_return,
-        &Cst::parse_call_statement,
-        &Cst::parse_assignment,
-    });
+CstNode const* Cst::getDefinition(std::string_view name) {
+    for (LazyBody& body : lazy) {
+        if (table.getName(body.function) == name) {
+            expand(body);
+            return body.definition;
+        }
+    }
+    return nullptr;
 }
 
-bool Cst::parse_compound() {
-    // std::cout << "compound start on line " << tk->getLine() << " with " << t.content << "\n";
-    while (parse_statement());
-    // std::cout << "compound end on line " << tk->getLine() << " with " << t.content << "\n";
-    return true;
+size_t Cst::countUnparsed() const {
+    return std::count_if(lazy.begin(), lazy.end(), [](const LazyBody& body) { return !body.parsed; });
 }
 
-bool Cst::parse_parameter_decl() {
-    if (!is_datatype_specifier(t)) {
-        return false;
+void Cst::expandAll() {
+    std::vector<LazyBody*> parsed;
+    for (LazyBody& body : lazy) {
+        if (!body.parsed) {
+            parse_body(body, arenas[0]);
+            parsed.push_back(&body);
+        }
     }
+    merge(parsed);
+    first_body_error();
+}
 
-    table.add_param(tk->peek().content, to_datatype(t));
+// forgets the expressions that start at the nodes it visits
+struct ExprEraser : CstWalker<ExprEraser, const CstNode> {
+    std::unordered_map<const CstNode*, uint32_t>& roots;
 
-    advance_sibling();
+    ExprEraser(std::unordered_map<const CstNode*, uint32_t>& roots) : roots(roots) {}
 
-    expect(not_reserved_word, "reserved word \"{}\" cannot be used for the name of a variable.", t.content);
-    expect_sibling(IDENTIFIER);
+    void pre(const CstNode* n) { roots.erase(n); }
+};
 
-    if (t.type == L_BRACKET) {
-        advance_sibling();
-        expect_sibling(INTEGER);
-        expect_sibling(R_BRACKET);
+bool Cst::edit(size_t offset, size_t removed, std::string_view inserted) {
+    edit_error.clear();
+    if (!text || !ok()) {
+        return false;
     }
 
-    return true;
-}
-
-bool Cst::parse_parameters() {
-    if (!is_datatype_specifier(t)) {
+    // the last definition that starts before the edit
+    auto found = std::upper_bound(definitions.begin(), definitions.end(), offset,
+                                  [](size_t o, const Definition& d) { return o < d.offset; });
+    if (found == definitions.begin()) {
+        return false;
+    }
+    size_t i = --found - definitions.begin();
+    Definition& d = definitions[i];
+    if (offset + removed > d.offset + d.length) {
         return false;
     }
 
-    while (t.type != END) {
-        if (!parse_parameter_decl()) {
-            syntaxError("Invalid parameter list");
-        }
+    std::string_view old(d.first->t.content.data(), d.length);
+    auto edited = std::make_unique<std::string>(old);
+    edited->replace(offset - d.offset, removed, inserted);
+    // the tokenizer only ends a word at the character after it
+    *edited += '\n';
 
-        if (t.type == R_PAREN) {
-            break;
-        }
+    // parsed the same way as the rest of the file, but on its own
+    SymbolTable symbols;
+    symbols.next_scope = d.scope;
+    Expressions edited_exprs;
+    CstNode* start = arenas[0].make(UNKNOWN);
 
-        expect_sibling(COMMA);
+    Tokenizer tk(*edited, 0, d.line);
+    TreeBuilder builder(symbols, arenas[0], start);
+    builder.max_depth = limits.max_depth;
+    if (build_expressions) {
+        builder.exprs = &edited_exprs;
     }
-
-    return true;
-}
-
-bool Cst::parse_procedure() {
-    if (t.content != "procedure") {
+    Parser<TreeBuilder> parser(&tk, builder, limits);
+    if (!parser.parseDefinition()) {
+        edit_error = parser.getError();
         return false;
     }
-
-    advance_child();  // procedure
-
-    expect(not_reserved_word, "reserved word \"{}\" cannot be the name of a procedure", t.content);
-    table.enter_function(t.content, {});
-    expect_sibling(IDENTIFIER);  // name
-
-    expect_sibling(L_PAREN);
-
-    if (t.content == "void") {
-        advance_sibling();
-    } else {
-        if (!parse_parameters()) {
-            syntaxError("Invalid procedure parameter list");
-        }
+    std::string_view keyword = start->child->t.content;
+    if ((keyword != "function" && keyword != "procedure") != d.declaration) {
+        return false;
     }
 
-    expect_sibling(R_PAREN);
-
-    expect_child(L_BRACE);
-
-    parse_compound();
-
-    expect_child(R_BRACE);
-
-    table.exit_function();
-
+    if (build_expressions) {
+        CstNode* next = d.last->child;
+        d.last->child = nullptr;
+        ExprEraser(exprs.roots).walk(d.first);
+        d.last->child = next;
+        exprs.append(edited_exprs);
+    }
+
+    // the nodes
+    CstNode* before = i == 0 ? root : definitions[i - 1].last;
+    before->child = start->child;
+    builder.current->child = d.last->child;
+
+    // the symbols, which moves the ones of the definitions after it
+    size_t count = symbols.getSymbols().size();
+    long long shifted = (long long)count - (long long)d.symbols;
+    table.replace(d.first_symbol, d.symbols, symbols);
+
+    // the edit may have added or removed characters before the first token
+    std::string_view first = start->child->t.content;
+    std::string_view last = builder.current->t.content;
+    size_t skipped = first.data() - edited->data();
+    long long moved = (long long)inserted.size() - (long long)removed;
+    long long lines = std::count(edited->begin(), edited->end() - 1, '\n') - std::count(old.begin(), old.end(), '\n');
+
+    d.first = start->child;
+    d.last = builder.current;
+    d.symbols = count;
+    d.offset += skipped;
+    d.length = last.data() + last.size() - first.data();
+    d.line += std::count(edited->begin(), edited->begin() + skipped, '\n');
+    d.text = std::move(edited);
+
+    for (size_t j = i + 1; j < definitions.size(); j++) {
+        definitions[j].offset += moved;
+        definitions[j].line += lines;
+        definitions[j].first_symbol += shifted;
+    }
     return true;
 }
 
-bool Cst::parse_function() {
-    if (t.content != "function") {
-        return false;
+void Cst::Expressions::append(const Expressions& other) {
+    std::vector<uint32_t> copies = pool.append(other.pool);
+    for (auto [first, root] : other.roots) {
+        roots[first] = copies[root];
     }
+}
 
-    advance_child();  // function
-
-    expect(is_datatype_specifier, "Expected datatype specifier after function declaration");
-
-    table.enter_function(tk->peek().content, to_datatype(t));
-    advance_sibling();  // return type
+uint32_t Cst::getExpression(const CstNode* first) const {
+    auto found = exprs.roots.find(first);
+    return found == exprs.roots.end() ? ExprPool::NONE : found->second;
+}
 
-    expect(not_reserved_word, "reserved word \"{}\" cannot be used for the name of a function.", t.content);
-    expect_sibling(IDENTIFIER);  // name
+struct ExprPrinter : CstWalker<ExprPrinter, const CstNode> {
+    const Cst& cst;
+    Writer& out;
 
-    expect_sibling(L_PAREN);
+    ExprPrinter(const Cst& cst, Writer& out) : cst(cst), out(out) {}
 
-    if (t.content == "void") {
-        advance_sibling();
-    } else {
-        if (!parse_parameters()) {
-            syntaxError("Empty parameter list not allowed");
+    void pre(const CstNode* n) {
+        uint32_t root = cst.getExpression(n);
+        if (root != ExprPool::NONE) {
+            cst.getExpressions().print(out, root);
+            out << "\n";
         }
     }
+};
 
-    expect_sibling(R_PAREN);
-
-    expect_child(L_BRACE);
-
-    if (!parse_compound()) {
-        syntaxError("Empty function body not allowed: must have a valid return");
-    }
-
-    expect_child(R_BRACE);
-
-    table.exit_function();
-
-    return true;
+void Cst::printExpressions(Writer& out) {
+    expandAll();
+    ExprPrinter(*this, out).walk(root);
 }
 
-bool Cst::parse_program_tail() {
-    bool decl = parse_first_accepted({&Cst::parse_function,
-                                      &Cst::parse_procedure,
-                                      &Cst::parse_declaration});
+// specific to the tree layout specified in the assignment:
+// siblings share a line, and each child starts a new one
+template <typename Output>
+struct CstPrinter : CstWalker<CstPrinter<Output>, const CstNode> {
+    Output& out;
 
-    if (decl) {
-        parse_program_tail();
-    }
-
-    return true;
-}
+    CstPrinter(Output& out) : out(out) {}
 
-bool Cst::parse_main() {
-    if (t.content != "procedure" || tk->peek().content != "main") {
-        return false;
+    void pre(const CstNode* n) {
+        out << n->t.content << (n->sib ? "   " : "\n");
     }
-    advance_child();    // procedure
-    table.enter_function(t.content, {});
-    advance_sibling();  // main
-
-    
+};
 
-    expect_sibling(L_PAREN);
-    expect("void", "Main procedure must have parameter type 'void', has {}", t.content);
-    advance_sibling();
+// lets CstPrinter print into a string
+struct StringOutput {
+    std::string& text;
 
-    expect_sibling(R_PAREN);
-
-    if (!parse_block()) {
-        syntaxError("Expected valid block statement following main declaration");
+    StringOutput& operator<<(std::string_view s) {
+        text += s;
+        return *this;
     }
+};
 
-    table.exit_function();
-
-    return true;
-}
-
-bool Cst::parse_program() {
-    if (t.type != IDENTIFIER) {
-        syntaxError("Programs should start with an identifier");
-    }
+// finds the last node of each top level definition that has another one after it, if
+// the tree can be cut there: the rest of the tree must all be below its child
+struct DefinitionEnds : CstWalker<DefinitionEnds, CstNode> {
+    std::vector<CstNode*> ends;
+    size_t braces = 0;
 
-    while (t.type != END) {
-        if (parse_main()) {
-            parse_program_tail();
-            break;
+    void pre(CstNode* n) {
+        if (n->t.type == L_BRACE) {
+            braces++;
+        } else if (n->t.type == R_BRACE && braces > 0) {
+            braces--;
+        } else if (n->t.type != SEMICOLON || braces > 0) {
+            return;
         }
-
-        bool decl = parse_first_accepted({&Cst::parse_function,
-                                          &Cst::parse_procedure,
-                                          &Cst::parse_declaration});
-
-        if (!decl) {
-            break;
+        if (braces == 0 && !n->sib && n->child && depth() == 0) {
+            ends.push_back(n);
         }
     }
-    expect(END, "There should be no content after the end of the program");
+};
 
-    return true;
-}
+void Cst::print(Writer& out) {
+    expandAll();
 
-void deleteTree(CstNode* node) {
-    if (!node) {
+    if (!root->child) {
+        out << "NULL NODE POINTER!!";
         return;
     }
-    deleteTree(node->child);
-    deleteTree(node->sib);
-    delete node;
+    CstPrinter<Writer>(out).walk(root->child);
 }
 
-void Cst::destroy() {
-    deleteTree(root);
-}
-
-void Cst::build() {
-    t = tk->next();
-    parse_program();
-}
+void Cst::print(Writer& out, unsigned threads) {
+    expandAll();
 
-// specific to the tree layout specified in the assignment
-// not a general BFS
-void printCstNode(CstNode* n) {
-    if (!n) {
-        std::cout << "NULL NODE POINTER!!";
+    DefinitionEnds splitter;
+    if (root->child && threads > 1) {
+        splitter.walk(root->child);
+    }
+    std::vector<CstNode*>& ends = splitter.ends;
+    if (ends.empty()) {
+        print(out);
         return;
     }
-    while (n) {
-        if (!n->sib && !n->child) {
-            std::cout << n->t.content << "\n";
-            break;
-        }
-        while (n->sib) {
-            std::cout << n->t.content << "   ";
-            n = n->sib;
-        }
-        std::cout << n->t.content << "\n";
 
-        if (n->child) {
-            n = n->child;
-        }
+    // each definition becomes a tree of its own until they are all printed
+    std::vector<CstNode*> starts = {root->child};
+    for (CstNode* end : ends) {
+        starts.push_back(end->child);
+        end->child = nullptr;
     }
-}
 
-void Cst::print() {
-    printCstNode(root->child);
-}
\ No newline at end of file
+    std::vector<std::string> buffers(starts.size());
+    std::atomic<size_t> next = 0;
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < std::min<size_t>(threads, starts.size()); w++) {
+        workers.emplace_back([&] {
+            for (size_t i = next++; i < starts.size(); i = next++) {
+                StringOutput text{buffers[i]};
+                CstPrinter<StringOutput>(text).walk(starts[i]);
+            }
+        });
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (size_t i = 0; i < ends.size(); i++) {
+        ends[i]->child = starts[i + 1];
+    }
+    for (const std::string& text : buffers) {
+        out << text;
+    }
+}
@@ -2,19 +2,40 @@
 #define CST_HPP
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <format>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include "expr.hpp"
 #include "tokenize.hpp"
+#include "writer.hpp"
 #include <optional>
+#include <span>
 #include <string_view>
-#include <variant>
+#include <utility>
 #include <iostream>
 
+/**
+ * @brief The functions, parameters and variables of a program.
+ *
+ * Symbols are stored as parallel arrays indexed by symbol id, with the parameters of
+ * every function in one more array, so that no symbol allocates anything. Ids are
+ * given out in the order symbols are added and never change. The order print() uses,
+ * which is the order of the source, is kept separately in getSymbols().
+ *
+ * Scopes are per function only. A variable declared in a block nested in a body gets
+ * the scope of the function, so one that hides another variable of the same function
+ * is listed with the same scope. Block scopes are only kept by Resolution, which binds
+ * every use to the innermost declaration.
+ */
 class SymbolTable {
-    
+   public:
     enum VariableType {
         Int,
         Char,
@@ -22,72 +43,164 @@ class SymbolTable {
         Bool
     };
 
-    struct Node;
-
-    struct FunctionType {
-        std::optional<VariableType> return_type;
-        std::vector<Node*> params;
+    enum class Kind : uint8_t {
+        Variable,
+        Function,   // has a return type
+        Procedure,  // has none
     };
 
-    struct Node {
-        std::string_view name;
-        std::variant<FunctionType, VariableType> payload;
-        uint32_t scope = 0;
-        Node* next = nullptr;
-    };
+    static constexpr uint32_t NONE = UINT32_MAX;
 
-    Node* head = nullptr;
-    Node* tail = nullptr;
+    /**
+     * @brief The id of every symbol, in the order of the source
+     */
+    const std::vector<uint32_t>& getSymbols() const { return order; }
 
-    uint32_t next_scope = 1;
+    std::string_view getName(uint32_t symbol) const { return names[name_ids[symbol]]; }
+    Kind getKind(uint32_t symbol) const { return kinds[symbol]; }
 
-    Node* current_function = nullptr;
+    /**
+     * @brief The type of a variable, or the return type of a function
+     */
+    VariableType getType(uint32_t symbol) const { return types[symbol]; }
 
-    uint32_t current_scope() { return current_function ? current_function->scope : 0; }
+    /**
+     * @brief 0 for globals, or the scope of the function a symbol is declared in, even
+     * inside a nested block, which is also the scope of the function itself
+     */
+    uint32_t getScope(uint32_t symbol) const { return scopes[symbol]; }
 
-    void add_node(Node* n) {
-        if (tail) {
-            tail->next = n;
-            tail = tail->next;
-        } else {
-            tail = n;
-            head = n;
-        }
+    /**
+     * @brief The ids of the parameters of a function, empty for a variable
+     */
+    std::span<const uint32_t> getParams(uint32_t symbol) const {
+        return std::span(params).subspan(first_params[symbol], param_counts[symbol]);
     }
 
-    Node* resolve(std::string_view name) {
-        Node* n = head;
-        uint32_t scope = current_scope();
-        while (n) {
-            if ((n->name == name && n->scope == 0) || n->scope == scope) {
-                break;
+    /**
+     * @brief The symbol with this name declared in exactly this scope, or NONE.
+     * The most recently added one, if it was declared more than once.
+     */
+    uint32_t lookup(uint32_t scope, std::string_view name) const;
+
+    void print(Writer& out) const;
+
+    /**
+     * @brief Print one line of print() for a symbol stored anywhere, like in a CstFile
+     *
+     * @param param_type Gives the type of the i-th of the param_count parameters
+     */
+    template <typename ParamType>
+    static void printSymbol(Writer& out, uint32_t scope, std::string_view name, Kind kind, VariableType type,
+                            uint32_t param_count, ParamType param_type) {
+        out << scope << " | " << name << " : ";
+        if (kind == Kind::Variable) {
+            out << vartype_to_name(type);
+        } else {
+            out << "function (";
+            if (param_count == 0) {
+                out << "void";
             }
+            for (uint32_t i = 0; i < param_count; i++) {
+                if (i) {
+                    out << ", ";
+                }
+                out << vartype_to_name(param_type(i));
+            }
+            out << ") --> " << (kind == Kind::Function ? vartype_to_name(type) : "void");
         }
-        return n;
+        out << "\n";
     }
 
+   private:
+    // by symbol id
+    std::vector<uint32_t> name_ids;
+    std::vector<Kind> kinds;
+    std::vector<VariableType> types;
+    std::vector<uint32_t> scopes;
+    std::vector<uint32_t> first_params;
+    std::vector<uint32_t> param_counts;
+    std::vector<uint32_t> shadowed;  // the symbol with the same name and scope indexed before it
+
+    std::vector<uint32_t> params;
+    std::vector<uint32_t> order;
+
+    // Every distinct name is interned once, into storage that outlives the text of the
+    // symbols (which edits can free), and found by open addressing with linear probing
+    // over name_slots. The symbols are then found the same way by scope and name id,
+    // in entries. An entry keeps the most recent symbol for its key, with the ones it
+    // hides chained through shadowed, and is never removed, only emptied.
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    struct Entry {
+        uint32_t scope;
+        uint32_t name_id = EMPTY;
+        uint32_t symbol = NONE;
+    };
+
+    std::vector<uint32_t> name_slots;
+    std::vector<std::string_view> names;
+    std::deque<std::string> storage;  // never moves its strings as it grows
+    std::vector<size_t> name_hashes;
+    std::vector<Entry> entries;
+    size_t used_entries = 0;
+
+    // the id of a name, or EMPTY if it was never interned
+    uint32_t find_name(std::string_view name, size_t hash) const;
+    uint32_t intern(std::string_view name);
+    Entry& entry(uint32_t scope, uint32_t name_id);
+    void index(uint32_t symbol);
+    void unindex(uint32_t symbol);
+
+    uint32_t next_scope = 1;
+
+    uint32_t current_function = NONE;
+    uint32_t function_scope = 0;
+
+    uint32_t current_scope() { return function_scope; }
+
+    uint32_t add_symbol(std::string_view name, Kind kind, VariableType type);
+
     void enter_function(std::string_view name, std::optional<VariableType> return_type) {
-        current_function = new Node{name, FunctionType{return_type, {}}, next_scope};
-        next_scope++;
-        add_node(current_function);
+        function_scope = next_scope++;
+        current_function = add_symbol(name, return_type ? Kind::Function : Kind::Procedure, return_type.value_or(Int));
+        first_params[current_function] = static_cast<uint32_t>(params.size());
     }
 
-    void add_param(std::string_view name, VariableType type) {
-        Node* p = new Node{name, type, current_scope()};
-        add_node(p);
-        std::get<FunctionType>(current_function->payload).params.push_back(p);
+    // continues a function whose header was added to another table, like the
+    // body of a function that was left for later
+    void resume_function(uint32_t scope) {
+        function_scope = scope;
     }
 
-    void exit_function() {
-        current_function = nullptr;
+    void add_param(std::string_view name, VariableType type) {
+        params.push_back(add_symbol(name, Kind::Variable, type));
+        param_counts[current_function]++;
     }
 
     void add_var(std::string_view name, VariableType type) {
-        Node* v = new Node{name, type, current_scope()};
-        add_node(v);
+        add_symbol(name, Kind::Variable, type);
     }
 
-    std::string_view vartype_to_name(VariableType t) {
+    void exit_function() {
+        current_function = NONE;
+        function_scope = 0;
+    }
+
+    // copies every symbol of other to the end of the arrays, and returns the id of
+    // the first copy. The order is left to the caller
+    uint32_t append(SymbolTable& other);
+
+    // replaces the count symbols at this position of the order with every symbol of
+    // other. The ids of the old ones are not reused
+    void replace(size_t position, size_t count, SymbolTable& other);
+
+    // moves every symbol of each table into this one, right after the symbol it is
+    // paired with, in one pass over the order. The pairs must be in the order of the
+    // symbols they go after
+    void splice(std::span<const std::pair<uint32_t, SymbolTable*>> parts);
+
+    static std::string_view vartype_to_name(VariableType t) {
         switch (t) {
             case VariableType::Bool:
                 return "bool";
@@ -99,35 +212,16 @@ class SymbolTable {
                 return "unknown";
         }
     }
-public:
-    void print() {
-        Node* n = head;
-        while (n) {
-            std::cout << n->scope << " | " << n->name << " : ";
-            if (VariableType* v = std::get_if<VariableType>(&n->payload)) {
-                std::cout << vartype_to_name(*v);
-
-            } else if (FunctionType* f = std::get_if<FunctionType>(&n->payload)) {
-                std::cout << "function (";
-                if (f->params.empty()) {
-                    std::cout << "void";
-                }
-                for (size_t i = 0; i < f->params.size(); i++) {
-                    if (i) {
-                        std::cout << ", ";
-                    }
-                    std::cout << vartype_to_name(std::get<VariableType>(f->params[i]->payload));
-                }
-                std::cout << ") --> " << (f->return_type.has_value() ? vartype_to_name(*(f->return_type)) : "void");
-            }
-            std::cout << "\n";
-            n = n->next;
-        }
-    }
 
     friend class Cst;
+    friend class CstFile;
 };
 
+class FlatCst;
+
+// see parser.hpp
+enum class Rule;
+
 struct CstNode {
     CstNode* child;
     CstNode* sib;
@@ -163,226 +257,495 @@ struct CstNode {
     }
 };
 
-class Cst {
-    using StNode = SymbolTable::Node;
-    using Datatype = SymbolTable::VariableType;
-
+/**
+ * @brief Allocates CstNodes in large chunks that are freed all at once when the
+ * arena is destroyed. Nodes never move, including when the arena itself is moved.
+ */
+class NodeArena {
    public:
-    Cst() = delete;
-    Cst(Tokenizer* tk) {
-        this->tk = tk;
-        root = new CstNode(UNKNOWN);
-        current = root;
-        error = {};
-        t = Token(UNKNOWN);
-        build();
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    CstNode* make(const Token& t) {
+        if (chunks.empty() || chunks.back().size() == chunks.back().capacity()) {
+            chunks.emplace_back();
+            chunks.back().reserve(CHUNK_SIZE);
+        }
+        return &chunks.back().emplace_back(t);
     }
 
-    ~Cst() {
-        destroy();
+   private:
+    // each chunk is reserved up front and never grows past it, so it never reallocates
+    std::vector<std::vector<CstNode>> chunks;
+};
+
+/**
+ * @brief Depth first traversal of a CstNode tree that keeps its state in an explicit
+ * stack, so long sibling chains and deep nesting can't overflow the native stack.
+ *
+ * The children of a node are its child and the sibling chain of that child. Derived
+ * classes hide pre() and/or post(), which are dispatched at compile time: pre(n) is
+ * called before the children of n are visited, and post(n) after all of them. The
+ * sibling of a node is read before post() is called, so post() may free the node.
+ *
+ * @tparam Derived The class implementing the hooks (CRTP)
+ * @tparam Node Either CstNode or const CstNode
+ */
+template <typename Derived, typename Node = CstNode>
+class CstWalker {
+   public:
+    void walk(Node* n) {
+        // without a post() hook, a node only needs to be kept on the stack to reach its sibling
+        constexpr bool has_post = !std::is_same_v<decltype(&Derived::post), void (CstWalker::*)(Node*)>;
+
+        while (n || !parents.empty()) {
+            if (!n) {
+                n = parents.back();
+                parents.pop_back();
+                Node* sib = n->sib;
+                derived().post(n);
+                n = sib;
+                continue;
+            }
+
+            derived().pre(n);
+
+            if (n->child && (has_post || n->sib)) {
+                parents.push_back(n);
+                n = n->child;
+            } else if (n->child) {
+                n = n->child;
+            } else {
+                Node* sib = n->sib;
+                derived().post(n);
+                n = sib;
+            }
+        }
     }
 
-    void print();
+   protected:
+    void pre(Node*) {}
+    void post(Node*) {}
 
-    std::string getError() { return error; }
-    bool ok() { return error.empty(); }
+    /**
+     * @brief The number of ancestors of the node currently being visited that are
+     * still on the stack. Only exact if Derived implements post()
+     */
+    size_t depth() const { return parents.size(); }
 
-    CstNode const* getRoot() const { return root; }
+   private:
+    std::vector<Node*> parents;
 
-    static bool is_relational_expression(Token t);
-    static bool is_numerical_operator(Token t);
-    static bool is_boolean_operator(Token t);
-    static bool is_boolean_literal(Token t);
-    static bool is_datatype_specifier(Token t);
-    static bool not_reserved_word(Token t);
-    static Datatype to_datatype(Token t) {
-        if (t.content == "int") {
-            return Datatype::Int;
-        } else if (t.content == "bool") {
-            return Datatype::Bool;
-        } else if (t.content == "char") {
-            return Datatype::Char;
-        } else {
-            assert(false);
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
+
+/**
+ * @brief One event the parser reported while building a Cst: entering or exiting a
+ * rule, or the node a token became. See CstOptions::rules
+ */
+struct RuleEvent {
+    enum Kind : uint8_t {
+        Enter,
+        Exit,
+        Node,
+    };
+
+    Kind kind;
+    Rule rule;            // of Enter and Exit
+    const CstNode* node;  // of Node
+};
+
+/**
+ * @brief Goes through the rule events of a Cst in the order the parser reported them,
+ * so that a pass over a finished tree sees the same structure as a ParseHandler.
+ *
+ * Derived classes hide enter(), exit() and/or node(), which are dispatched at compile
+ * time. node(n, index) is given the position of the token among the ones its rule
+ * reported itself, without those of the rules inside of it, like 2 for the name in
+ * function int f (. rule() is the rule of the node, or the one being entered or exited.
+ *
+ * @tparam Derived The class implementing the hooks (CRTP)
+ */
+template <typename Derived>
+class RuleWalker {
+   public:
+    void walk(std::span<const RuleEvent> events) {
+        for (const RuleEvent& e : events) {
+            switch (e.kind) {
+                case RuleEvent::Enter:
+                    open.push_back({e.rule, 0});
+                    derived().enter(e.rule);
+                    break;
+                case RuleEvent::Exit:
+                    derived().exit(e.rule);
+                    open.pop_back();
+                    break;
+                case RuleEvent::Node:
+                    derived().node(e.node, open.back().tokens++);
+                    break;
+            }
         }
     }
 
-    SymbolTable table;
+   protected:
+    void enter(Rule) {}
+    void exit(Rule) {}
+    void node(const CstNode*, size_t) {}
+
+    /**
+     * @brief The current rule, or the one this many rules outside of it
+     */
+    Rule rule(size_t outer = 0) const { return open[open.size() - 1 - outer].rule; }
+
+    size_t depth() const { return open.size(); }
 
    private:
-    Token t;
-    Tokenizer* tk;
-    CstNode* root;
-    CstNode* current;
-    
+    struct Open {
+        Rule rule;
+        size_t tokens;
+    };
+    std::vector<Open> open;
 
-    std::string error;
+    Derived& derived() { return static_cast<Derived&>(*this); }
+};
 
-    void build();
-    void destroy();
+/**
+ * @brief A syntax error, without the "Syntax error on line" prefix of Cst::getError()
+ */
+struct Diagnostic {
+    size_t line;
+    std::string message;
+};
 
-    void advance_child() {
-        current->child = new CstNode(t);
-        current = current->child;
-        t = tk->next();
-    }
+/**
+ * @brief How a parse ended. Hitting one of the ParseLimits halts the parse right away,
+ * and is also reported as an error, with the line the parse had reached
+ */
+enum class ParseStatus : uint8_t {
+    Ok,
+    SyntaxError,
+    TooManyNodes,
+    TooManyBytes,
+    TooDeep,
+    TimedOut,
+};
 
-    void advance_sibling() {
-        current->sib = new CstNode(t);
-        current = current->sib;
-        t = tk->next();
-    }
+/**
+ * @brief Bounds on what a single parse may use, for programs that can't be trusted.
+ *
+ * The nodes are counted as each token is added to the tree, and the clock is only read
+ * every DEADLINE_INTERVAL nodes, so checking them costs a few instructions per token.
+ * Tokens skipped while recovering from a syntax error are not counted, since that
+ * takes time linear in the size of the file and allocates nothing.
+ */
+struct ParseLimits {
+    static constexpr size_t DEFAULT_MAX_DEPTH = 10000;
+    static constexpr size_t DEADLINE_INTERVAL = 1024;
 
-    void expect_child(TokenType type) {
-        expect(type);
-        advance_child();
-    }
+    size_t max_nodes = SIZE_MAX;
 
-    void expect_sibling(TokenType type) {
-        expect(type);
-        advance_sibling();
-    }
+    /// @brief Of the nodes of the tree
+    size_t max_bytes = SIZE_MAX;
 
-    bool parse_program();
-    bool parse_main();
-    bool parse_program_tail();
-    bool parse_procedure();
-    bool parse_function();
-    bool parse_parameters();
-    bool parse_block();
-    bool parse_compound();
-    bool parse_statement();
-    bool parse_return();
-    bool parse_declaration();
-    bool parse_call();
-    bool parse_call_statement();
-    bool parse_sizeof();
-    bool parse_getchar();
-    bool parse_printf();
-    bool parse_assignment();
-    bool parse_iteration();
-    bool parse_selection();
-    bool parse_iteration_assignment();
-    bool parse_expression();
-    bool parse_initialization();
-    bool parse_boolean_expression();
-    bool parse_numerical_expression();
-    bool parse_relational_expression();
-    bool parse_numerical_operand();
-    bool parse_identifier_and_ident_arr_param_list();
-    bool parse_identifier_and_ident_arr_list();
-    bool parse_parameter_decl();
-
-    bool in_boolean_prefix();
-
-    static bool any(const Token& t, TokenType aType) {
-        return t.type == aType;
-    }
+    /// @brief How many rules may be nested inside each other, see ParserBase::MAX_DEPTH
+    size_t max_depth = DEFAULT_MAX_DEPTH;
 
-    static bool any(const Token& t, const char* aContent) {
-        return t.content == aContent;
-    }
+    std::optional<std::chrono::steady_clock::time_point> deadline;
 
-    static bool any(const Token& t, bool (*aTest)(Token)) {
-        return aTest(t);
-    }
+    /**
+     * @brief The default limits, changed by any of CHAGALITE_MAX_NODES,
+     * CHAGALITE_MAX_BYTES, CHAGALITE_MAX_DEPTH and CHAGALITE_TIMEOUT_MS (from now)
+     */
+    static ParseLimits fromEnvironment();
 
     /**
-     * @brief Helper to test if a token matches either a TokenType,
-     * token content string, or predicate function
+     * @brief The node, byte and depth limits that differ from the defaults, like
+     * " max_nodes=100", to tell apart outputs that depend on them
      */
-    template <typename... Args>
-    static bool any(const Token& t, Args... args) {
-        return (any(t, args) || ...);
-    }
+    std::string describe() const;
+};
 
+/**
+ * @brief Optional ways to run the parse of a Cst
+ */
+struct CstOptions {
     /**
-     * @brief Emit a formatted syntax error. If this is called twice, only the
-     * first will be recorded in the error string.
+     * @brief Streaming mode: instead of building the tree, every node is written to
+     * the sink in the format of Cst::print() as soon as it is created, and discarded
+     * once the next node is attached. The tree is left empty.
      *
-     * Arguments are forwards to std::format() for the error message.
+     * The output is only terminated if the parse succeeded. Output already flushed
+     * by the sink before a syntax error was found cannot be taken back, so callers
+     * should keep the rest of it too, to print the same whatever the buffer size.
+     */
+    Writer* sink = nullptr;
+
+    /**
+     * @brief Only fill in the symbol table. Signatures and declarations are parsed
+     * fully, but the other statements of function bodies are skimmed by matching
+     * braces, so syntax errors in them are not reported. The tree is left empty.
+     */
+    bool declarations_only = false;
+
+    /**
+     * @brief Only parse the signatures of functions and procedures, and skip their
+     * bodies by matching braces. A body is parsed the first time it is needed: by
+     * Cst::getDefinition() for that function, or by Cst::print() for all of them. The
+     * body of main is always parsed right away.
      *
-     * Automatically prints the line number, and the line itself if DEBUG is defined
+     * Until then, the symbol table is missing the variables declared in the body,
+     * and syntax errors in it are not reported. Once it is parsed, they are reported
+     * by Cst::getError() and Cst::getDiagnostics() like any other. The body's variables are put in the
+     * same place in the symbol table as they would have been without this option.
      */
-    template <typename... Args>
-    void syntaxError(std::format_string<Args...> fmt, Args&&... args) {
-        if (!ok()) {
-            return;
-        }
+    bool lazy_bodies = false;
 
-#ifdef DEBUG
-        // show extra context in debug
-        error = std::format("Syntax error on line {}: {}\n{}",
-                            tk->getLine(),
-                            std::format(fmt, std::forward<Args>(args)...),
-                            tk->getLineDebug());
+    /**
+     * @brief Parallel mode: if not 0, the bodies are skipped like with lazy_bodies,
+     * then all of them are parsed on this many worker threads before the constructor
+     * returns. The tree, symbol table and error are the same as without this option.
+     */
+    unsigned threads = 0;
 
-#else
-        error = std::format("Syntax error on line {}: {}",
-                            tk->getLine(),
-                            std::format(fmt, std::forward<Args>(args)...));
+    /**
+     * @brief Also build a precedence-correct tree for every expression, next to the
+     * flat sibling chain of its tokens in the CST. See Cst::getExpression()
+     *
+     * This is a second pass over the tokens of each expression, once the expression
+     * rules of the parser, with their lookahead and overlapping productions, have
+     * matched it. It adds to the parse rather than replacing any of it: those rules
+     * still decide which programs are valid and what their syntax errors say, and
+     * run the same way with or without this option, which only costs anything when
+     * it is set.
+     */
+    bool expressions = false;
+
+    /**
+     * @brief Keep what Cst::edit() needs: a copy of the source for the tokens to point
+     * into, and where each top level definition is. Ignored with any of the options
+     * above except expressions.
+     */
+    bool incremental = false;
+
+    /**
+     * @brief Also keep every rule the parser entered and exited, with the nodes of the
+     * tokens in between, for passes that need to know what each token is part of. See
+     * Cst::getRules(). Only kept when the whole tree is built in one parse, so it is
+     * ignored with sink, declarations_only, lazy_bodies, threads and incremental.
+     */
+    bool rules = false;
+
+    /**
+     * @brief The node, byte and depth limits apply to each parse separately: the whole
+     * program, each body left for later, and each edit. The deadline is the same for all
+     */
+    ParseLimits limits = {};
+};
+
+class Cst {
+   public:
+    Cst() = delete;
+    Cst(Tokenizer* tk) : Cst(tk, CstOptions{}) {}
+    Cst(Tokenizer* tk, Writer* sink) : Cst(tk, CstOptions{.sink = sink}) {}
 
-#endif
+    Cst(Tokenizer* tk, CstOptions options) {
+        arenas.emplace_back();
+        root = arenas[0].make(UNKNOWN);
+        error = {};
+        build(tk, options);
     }
 
+    void print(Writer& out);
+
+    /**
+     * @brief Print the same bytes as print(), but format each top level definition
+     * into a buffer of its own on this many threads, then write the buffers in order
+     */
+    void print(Writer& out, unsigned threads);
+
+    std::string getError() { return error; }
+    bool ok() const { return error.empty(); }
+
+    /**
+     * @brief Which limit stopped the parse, if any, or else whether it found a syntax error
+     */
+    ParseStatus getStatus();
+
+    /**
+     * @brief Every syntax error found, in the order of the file. The parse continues
+     * after each error, so there may be more than one. The tree and symbol table are
+     * still incomplete if there are any.
+     */
+    std::vector<Diagnostic> getDiagnostics();
+
+    CstNode const* getRoot() const { return root; }
+
+    /**
+     * @brief Copy the tree into the flat preorder layout, whose FlatCst::Cursor moves
+     * through it like getRoot() does through the nodes, to save it in a CstFile. See
+     * flat_cst.hpp
+     */
+    FlatCst flatten() const;
+
+    /**
+     * @brief The source the tokens point into, except for those of edited definitions
+     */
+    std::string_view getSource() const { return source; }
+
+    /**
+     * @brief Get the first node of the definition of a function or procedure, parsing
+     * its body first if it was left for later (see CstOptions::lazy_bodies)
+     *
+     * @return The node of the "function" or "procedure" keyword, or nullptr if there
+     * is no deferred body with that name
+     */
+    CstNode const* getDefinition(std::string_view name);
+
     /**
-     * @brief Expect the current token to match the pattern, which can be a
-     * token type enum, a string to check against the token content, or a
-     * predicate function to call on the current token.
+     * @brief How many of the bodies left for later have not been parsed yet
+     */
+    size_t countUnparsed() const;
+
+    /**
+     * @brief Parse every body that was left for later
+     */
+    void expandAll();
+
+    /**
+     * @brief Change the source of a Cst built with CstOptions::incremental, and parse
+     * only the top level definition the change is in again. Its nodes and symbols are
+     * replaced, and the definitions after it are moved by the change in length and
+     * lines without being visited.
      *
-     * If the token does not match, emit a formatted syntax error
+     * The offset is in the source as it is after the edits so far, without comments.
+     * The nodes of the old definition are only freed with the Cst.
      *
-     * @tparam T either TokenType, const char*, or a Token --> bool function
-     * @tparam Args The type arguments to std::format
-     * @param expected The patten to expect
-     * @param fmt The format string for the syntax error
-     * @param args The value arguments to std::format
-     * @return true if the token matched
-     * @return false if the token did not match
+     * @param offset Where the change starts
+     * @param removed How many characters are replaced
+     * @param inserted What they are replaced with
+     * @return false if the Cst is not incremental or has a syntax error, the change is
+     * not inside of one definition, or the definition would not parse on its own as
+     * the same kind of definition. Nothing is changed then, and the whole source needs
+     * to be parsed again.
      */
-    template <typename T, typename... Args>
-    bool expect(T expected, std::format_string<Args...> fmt, Args&&... args) {
-        if (!ok()) {
-            return false;
-        }
-        if (!any(t, expected)) {
-            syntaxError(fmt, std::forward<Args>(args)...);
-            return false;
-        }
-        return true;
-    }
+    bool edit(size_t offset, size_t removed, std::string_view inserted);
+
+    /**
+     * @brief The syntax error in the edited definition that made the last edit() fail,
+     * in the same format as getError(), with the line in the edited source. Empty if
+     * it succeeded or failed for another reason
+     */
+    std::string getEditError() const { return edit_error; }
 
     /**
-     * @brief Expect the current token to match the given token type or content
-     * Otherwise, emit a syntax error with the current line number.
+     * @brief Get the tree of the expression that starts at a node, if the Cst was
+     * built with CstOptions::expressions
      *
-     * @tparam T either TokenType or const char*
-     * @param expected the expected token type or content string
-     * @return true if the current token matches
-     * @return false otherwise
+     * @param first The node of the first token of the expression
+     * @return The index of the root in getExpressions(), or ExprPool::NONE if no
+     * expression starts at that node
      */
-    template <typename T>
-    bool expect(T expected) {
-        if (!ok()) {
-            return false;
-        }
-        if (!any(t, expected)) {
-            syntaxError("Expected {}, got \"{}\" ({})", expected, t.content, t.type);
-            return false;
-        }
-        return true;
-    }
+    uint32_t getExpression(const CstNode* first) const;
 
-    bool parse_first_accepted(std::initializer_list<bool (Cst::*)()> f_args) {
-        bool ret = false;
-        for (auto f : f_args) {
-            ret = (this->*f)();
-            if (ret) {
-                break;
-            }
-        }
-        return ret;
-    }
+    const ExprPool& getExpressions() const { return exprs.pool; }
+
+    /**
+     * @brief The rule events of the parse, in order, if the Cst was built with
+     * CstOptions::rules. Empty otherwise
+     */
+    std::span<const RuleEvent> getRules() const { return rules; }
+
+    /**
+     * @brief Print the tree of every expression in the order they appear, one per line
+     */
+    void printExpressions(Writer& out);
+
+    SymbolTable table;
+
+   private:
+    CstNode* root;
+
+    // owns every node of the tree. the first arena is used by the main thread,
+    // and each worker of the parallel mode gets one of its own
+    std::vector<NodeArena> arenas;
+
+    std::string error;
+    std::vector<Diagnostic> diagnostics;
+
+    ParseLimits limits;
+    ParseStatus limit = ParseStatus::Ok;  // the first limit any parse hit
+
+    // the file the tokens point into
+    std::string_view source;
+
+    struct Expressions {
+        ExprPool pool;
+        std::unordered_map<const CstNode*, uint32_t> roots;
+
+        void append(const Expressions& other);
+    };
+
+    // empty unless built with CstOptions::expressions
+    Expressions exprs;
+    bool build_expressions = false;
+
+    // empty unless built with CstOptions::rules
+    std::vector<RuleEvent> rules;
+
+    // a function or procedure body that has not been parsed yet, see CstOptions::lazy_bodies
+    struct LazyBody {
+        CstNode* definition;  // function or procedure keyword
+        CstNode* open;        // the child of { is } until the body is parsed
+        CstNode* close;
+        uint32_t function;
+        uint32_t last_symbol;  // the body's symbols go after this one
+        size_t offset;                   // first character after the {
+        size_t line;
+        bool parsed = false;
+
+        // filled in by parse_body(), so that bodies can be parsed at the same time
+        SymbolTable symbols;
+        Expressions exprs;
+        std::string error;
+        std::vector<Diagnostic> diagnostics;
+        ParseStatus limit = ParseStatus::Ok;
+    };
+
+    std::vector<LazyBody> lazy;
+
+    // a top level definition of an incremental Cst, see edit()
+    struct Definition {
+        CstNode* first;
+        CstNode* last;
+        size_t first_symbol;  // its position in the order of the table's symbols
+        size_t symbols;       // how many of the table's symbols are from this definition
+        uint32_t scope;       // given to the function or procedure
+        bool declaration;
+        size_t offset;  // of the first character, in the source after every edit
+        size_t length;
+        size_t line;
+
+        // what the tokens point into, once the definition has been edited
+        std::unique_ptr<std::string> text;
+    };
+
+    // empty unless built with CstOptions::incremental
+    std::unique_ptr<std::string> text;
+    std::vector<Definition> definitions;
+    std::string edit_error;
+
+    struct TableBuilder;
+    struct TreeBuilder;
+    struct TreeStreamer;
+    struct DeclarationScanner;
+    struct LazyTreeBuilder;
+    struct DefinitionTracker;
+
+    void build(Tokenizer* tk, CstOptions options);
+    void expand(LazyBody& body);
+    void parse_body(LazyBody& body, NodeArena& arena);
+    void merge(std::span<LazyBody* const> bodies);
+    void expand_parallel(unsigned threads);
+    void first_body_error();
 };
 
 #endif /* CST_HPP */
@@ -0,0 +1,235 @@
+#include "cst_file.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr char MAGIC[8] = {'C', 'H', 'A', 'G', 'A', 'C', 'S', 'T'};
+constexpr uint32_t VERSION = 2;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t nodes;
+    uint32_t symbols;
+    uint32_t params;
+    uint32_t string_bytes;
+    uint32_t padding;
+};
+
+// every section is a multiple of 4 bytes long, except the strings, which come last
+size_t file_size(const Header& h) {
+    return sizeof(Header) + size_t(h.nodes) * (sizeof(FlatCst::Node) + sizeof(FlatCst::Token)) +
+           size_t(h.symbols) * sizeof(CstFile::Symbol) + size_t(h.params) * sizeof(uint32_t) + h.string_bytes;
+}
+
+// the image of the file, built in memory so that it can be written all at once
+class Image {
+    std::vector<char> bytes;
+
+   public:
+    template <typename T>
+    void add(const T& value) {
+        const char* p = reinterpret_cast<const char*>(&value);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+
+    void add(std::string_view s) { bytes.insert(bytes.end(), s.begin(), s.end()); }
+
+    void reserve(size_t size) { bytes.reserve(size); }
+
+    template <typename T>
+    T& at(size_t offset) {
+        return *reinterpret_cast<T*>(bytes.data() + offset);
+    }
+
+    std::string_view view() const { return {bytes.data(), bytes.size()}; }
+};
+
+// stores each distinct string once
+class Strings {
+    std::unordered_map<std::string_view, uint32_t> offsets;
+    std::string data;
+
+   public:
+    uint32_t add(std::string_view s) {
+        auto [it, added] = offsets.try_emplace(s, static_cast<uint32_t>(data.size()));
+        if (added) {
+            data += s;
+        }
+        return it->second;
+    }
+
+    std::string_view view() const { return data; }
+};
+
+}  // namespace
+
+std::string CstFile::save(const char* path, const FlatCst& cst, const SymbolTable& table) {
+    Strings strings;
+
+    // the text of the tokens is stored once per distinct string, instead of the whole source
+    const FlatCst::View& tree = cst.getView();
+    std::vector<FlatCst::Token> tokens;
+    tokens.reserve(tree.size());
+    for (uint32_t i = 0; i < tree.size(); i++) {
+        ::Token t = tree.getToken(i);
+        tokens.push_back({static_cast<uint32_t>(t.type), strings.add(t.content), static_cast<uint32_t>(t.content.size())});
+    }
+
+    // the position of each symbol in the file, by symbol id
+    std::vector<uint32_t> positions(table.name_ids.size());
+    for (uint32_t i = 0; i < table.getSymbols().size(); i++) {
+        positions[table.getSymbols()[i]] = i;
+    }
+
+    std::vector<Symbol> symbols;
+    std::vector<uint32_t> params;
+    for (uint32_t id : table.getSymbols()) {
+        std::string_view name = table.getName(id);
+        Symbol s = {strings.add(name), static_cast<uint32_t>(name.size()), table.getScope(id), 0, 0, 0, 0, 0, 0};
+        s.type = static_cast<uint8_t>(table.getType(id));
+        if (table.getKind(id) != SymbolTable::Kind::Variable) {
+            s.is_function = 1;
+            s.has_return = table.getKind(id) == SymbolTable::Kind::Function;
+            s.first_param = static_cast<uint32_t>(params.size());
+            s.param_count = static_cast<uint32_t>(table.getParams(id).size());
+            for (uint32_t p : table.getParams(id)) {
+                params.push_back(positions[p]);
+            }
+        }
+        symbols.push_back(s);
+    }
+
+    Header header = {{}, VERSION, cst.size(), static_cast<uint32_t>(symbols.size()),
+                     static_cast<uint32_t>(params.size()), static_cast<uint32_t>(strings.view().size()), 0};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+
+    Image image;
+    image.reserve(file_size(header));
+    image.add(header);
+    for (const FlatCst::Node& n : tree.getNodes()) {
+        image.add(n);
+    }
+    for (const FlatCst::Token& t : tokens) {
+        image.add(t);
+    }
+    for (const Symbol& s : symbols) {
+        image.add(s);
+    }
+    for (uint32_t p : params) {
+        image.add(p);
+    }
+    image.add(strings.view());
+
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return std::format("ERROR: Failed to open {}: {}", path, std::strerror(errno));
+    }
+
+    std::string_view data = image.view();
+    while (!data.empty()) {
+        ssize_t n = ::write(fd, data.data(), data.size());
+        if (n < 0 && errno != EINTR) {
+            std::string error = std::format("ERROR: Failed to write {}: {}", path, std::strerror(errno));
+            ::close(fd);
+            return error;
+        } else if (n > 0) {
+            data.remove_prefix(n);
+        }
+    }
+    ::close(fd);
+    return {};
+}
+
+CstFile::CstFile(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        error = "ERROR: Failed to open file";
+        return;
+    }
+
+    struct stat info;
+    if (::fstat(fd, &info) == 0 && size_t(info.st_size) >= sizeof(Header)) {
+        length = info.st_size;
+        mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+        }
+    }
+    ::close(fd);
+
+    if (!mapping || !check()) {
+        error = "ERROR: Not a saved CST file";
+    }
+}
+
+CstFile::~CstFile() {
+    if (mapping) {
+        ::munmap(mapping, length);
+    }
+}
+
+// finds the sections, and makes sure that every index in them is in bounds
+bool CstFile::check() {
+    const char* base = static_cast<const char*>(mapping);
+    const Header& h = *reinterpret_cast<const Header*>(base);
+    if (std::memcmp(h.magic, MAGIC, sizeof(MAGIC)) != 0 || h.version != VERSION || file_size(h) != length) {
+        return false;
+    }
+
+    const char* p = base + sizeof(Header);
+    std::span<const FlatCst::Node> nodes(reinterpret_cast<const FlatCst::Node*>(p), h.nodes);
+    p += nodes.size_bytes();
+    std::span<const FlatCst::Token> tokens(reinterpret_cast<const FlatCst::Token*>(p), h.nodes);
+    p += tokens.size_bytes();
+    symbols = {reinterpret_cast<const Symbol*>(p), h.symbols};
+    p += symbols.size_bytes();
+    params = {reinterpret_cast<const uint32_t*>(p), h.params};
+    p += params.size_bytes();
+    strings = {p, h.string_bytes};
+
+    auto in_bounds = [&](uint32_t i) { return i == FlatCst::NONE || i < nodes.size(); };
+    for (const FlatCst::Node& n : nodes) {
+        if (!in_bounds(n.child) || !in_bounds(n.sib)) {
+            return false;
+        }
+    }
+    for (const FlatCst::Token& t : tokens) {
+        if (t.offset > strings.size() || t.length > strings.size() - t.offset) {
+            return false;
+        }
+    }
+    for (const Symbol& s : symbols) {
+        if (s.offset > strings.size() || s.length > strings.size() - s.offset || s.type > SymbolTable::Bool ||
+            (s.is_function && (s.first_param > params.size() || s.param_count > params.size() - s.first_param))) {
+            return false;
+        }
+    }
+    for (uint32_t param : params) {
+        if (param >= symbols.size() || symbols[param].is_function) {
+            return false;
+        }
+    }
+
+    view = FlatCst::View(nodes, tokens, strings);
+    return true;
+}
+
+void CstFile::printSymbols(Writer& out) const {
+    using VariableType = SymbolTable::VariableType;
+    for (const Symbol& s : symbols) {
+        SymbolTable::Kind kind = !s.is_function ? SymbolTable::Kind::Variable
+                                 : s.has_return ? SymbolTable::Kind::Function
+                                                : SymbolTable::Kind::Procedure;
+        SymbolTable::printSymbol(out, s.scope, getName(s), kind, static_cast<VariableType>(s.type), s.param_count,
+                                 [&](uint32_t i) { return static_cast<VariableType>(symbols[params[s.first_param + i]].type); });
+    }
+}
@@ -0,0 +1,101 @@
+/**
+ * @file cst_file.hpp
+ * @author Hartley Blakey
+ * @brief Binary files holding a finished parse, so it can be used without parsing again
+ */
+
+#ifndef CST_FILE_HPP
+#define CST_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "cst.hpp"
+#include "flat_cst.hpp"
+#include "tokenize.hpp"
+#include "writer.hpp"
+
+/**
+ * @brief Read-only view of a saved CST and symbol table, mapped into memory.
+ *
+ * The file holds the nodes and tokens of a FlatCst, the symbols
+ * in the order of SymbolTable::print(), and one copy of each distinct string they use.
+ * Loading it only maps and checks the file, nothing is allocated per node or symbol.
+ * Numbers are stored in the byte order of the machine that wrote the file.
+ */
+class CstFile {
+   public:
+    struct Symbol {
+        uint32_t offset;  // of the name, in the strings
+        uint32_t length;
+        uint32_t scope;
+        uint8_t is_function;
+        uint8_t type;  // the variable type, or the return type of a function
+        uint8_t has_return;
+        uint8_t padding;
+        uint32_t first_param;  // in getParams(), for a function
+        uint32_t param_count;
+    };
+
+    /**
+     * @brief Write the tree and symbol table of a parse to a file, with a single write(2)
+     *
+     * @return An error message, or the empty string if the file was written
+     */
+    static std::string save(const char* path, const FlatCst& cst, const SymbolTable& table);
+
+    /**
+     * @brief Map a file written by save(). Check ok() before using it.
+     */
+    explicit CstFile(const char* path);
+    ~CstFile();
+
+    CstFile(const CstFile&) = delete;
+    CstFile& operator=(const CstFile&) = delete;
+
+    bool ok() const { return error.empty(); }
+    std::string getError() const { return error; }
+
+    /**
+     * @brief The tree, whose tokens point into the mapped file
+     */
+    const FlatCst::View& getView() const { return view; }
+
+    FlatCst::Cursor getRoot() const { return view.getRoot(); }
+
+    std::span<const Symbol> getSymbols() const { return symbols; }
+
+    /**
+     * @brief The symbol index of each parameter of every function
+     */
+    std::span<const uint32_t> getParams() const { return params; }
+
+    std::string_view getName(const Symbol& s) const { return strings.substr(s.offset, s.length); }
+
+    /**
+     * @brief Print the tree in the same format as Cst::print()
+     */
+    void print(Writer& out) const { view.print(out); }
+
+    /**
+     * @brief Print the symbols in the same format as SymbolTable::print()
+     */
+    void printSymbols(Writer& out) const;
+
+   private:
+    void* mapping = nullptr;
+    size_t length = 0;
+    std::string error;
+
+    FlatCst::View view;
+    std::span<const Symbol> symbols;
+    std::span<const uint32_t> params;
+    std::string_view strings;
+
+    bool check();
+};
+
+#endif /* CST_FILE_HPP */
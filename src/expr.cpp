@@ -0,0 +1,337 @@
+#include "expr.hpp"
+
+namespace {
+
+// how tightly a binary operator holds its operands, or 0 if the token is not one
+int binding_power(TokenType type) {
+    switch (type) {
+        case BOOLEAN_OR:
+            return 1;
+        case BOOLEAN_AND:
+            return 2;
+        case BOOLEAN_EQUAL:
+        case BOOLEAN_NOT_EQUAL:
+        case LT:
+        case LT_EQUAL:
+        case GT:
+        case GT_EQUAL:
+            return 3;
+        case PLUS:
+        case MINUS:
+            return 4;
+        case ASTERISK:
+        case DIVIDE:
+        case MODULO:
+            return 5;
+        case CARET:
+            return 6;
+        default:
+            return 0;
+    }
+}
+
+constexpr int UNARY_POWER = 7;
+
+// whether a run of operators with this binding power is folded into one Chain
+bool chains(int power) {
+    return power != 3 && power != 6;
+}
+
+}  // namespace
+
+// precedence climbing over the tokens of one expression. Operators of the same
+// precedence are folded in a loop, so only brackets, arguments, unary operators, ^ and
+// tighter operators to the right of looser ones recurse. The last kind can only nest as
+// many times as there are precedences, so only the others count towards the depth
+class ExprPool::Builder {
+    ExprPool& pool;
+    std::span<const Token> tokens;
+    size_t i = 0;
+    size_t depth = 0;
+    size_t max_depth;
+    bool too_deep = false;
+
+   public:
+    Builder(ExprPool& pool, std::span<const Token> tokens, size_t max_depth)
+        : pool(pool), tokens(tokens), max_depth(max_depth) {}
+
+    uint32_t parse() {
+        uint32_t root = parse_operators(0);
+        if (too_deep) {
+            return TOO_DEEP;
+        }
+        return i == tokens.size() ? root : NONE;
+    }
+
+   private:
+    TokenType peek() const { return i < tokens.size() ? tokens[i].type : END; }
+
+    bool accept(TokenType type) {
+        if (peek() != type) {
+            return false;
+        }
+        i++;
+        return true;
+    }
+
+    uint32_t add(Expr::Kind kind, const Token& token, uint32_t lhs = NONE, uint32_t rhs = NONE) {
+        return pool.add({kind, token, lhs, rhs});
+    }
+
+    // parse_operators() one level deeper
+    uint32_t nested(int min_power) {
+        if (depth == max_depth) {
+            too_deep = true;
+            return NONE;
+        }
+        depth++;
+        uint32_t lhs = parse_operators(min_power);
+        depth--;
+        return lhs;
+    }
+
+    // an operand, followed by every operator that binds tighter than min_power
+    uint32_t parse_operators(int min_power) {
+        uint32_t lhs = parse_operand();
+
+        while (lhs != NONE && binding_power(peek()) > min_power) {
+            const Token& op = tokens[i++];
+            int power = binding_power(op.type);
+
+            if (!chains(power)) {
+                uint32_t rhs = op.type == CARET ? nested(power - 1) : parse_operators(power);
+                if (rhs == NONE) {
+                    return NONE;
+                }
+                lhs = add(Expr::Binary, op, lhs, rhs);
+                continue;
+            }
+
+            // every operand up to the next operator with a different precedence
+            size_t start = pool.pending.size();
+            pool.pending.push_back({Token(), lhs});
+            Token next = op;
+            while (true) {
+                uint32_t rhs = parse_operators(power);
+                if (rhs == NONE) {
+                    return NONE;
+                }
+                pool.pending.push_back({next, rhs});
+
+                if (binding_power(peek()) != power) {
+                    break;
+                }
+                next = tokens[i++];
+            }
+            lhs = add_operands(Expr::Chain, op, start);
+        }
+
+        return lhs;
+    }
+
+    // moves the pending operands from start onwards into the pool, next to each other
+    uint32_t add_operands(Expr::Kind kind, const Token& token, size_t start) {
+        uint32_t node = pool.add({kind, token, NONE, NONE}, std::span(pool.pending).subspan(start));
+        pool.pending.resize(start);
+        return node;
+    }
+
+    uint32_t parse_operand() {
+        if (i == tokens.size()) {
+            return NONE;
+        }
+        const Token& t = tokens[i++];
+
+        switch (t.type) {
+            case L_PAREN: {
+                uint32_t inner = nested(0);
+                return accept(R_PAREN) ? inner : NONE;
+            }
+            case PLUS:
+            case MINUS:
+            case BOOLEAN_NOT: {
+                uint32_t operand = nested(UNARY_POWER);
+                return operand == NONE ? NONE : add(Expr::Unary, t, operand);
+            }
+            case INTEGER:
+                return add(Expr::Literal, t);
+            case SINGLE_QUOTE:
+            case DOUBLE_QUOTE:
+                return parse_quoted(t.type);
+            case IDENTIFIER:
+                if (accept(L_PAREN)) {
+                    return parse_call(t);
+                }
+                if (accept(L_BRACKET)) {
+                    uint32_t index = nested(0);
+                    return index != NONE && accept(R_BRACKET) ? add(Expr::Index, t, index) : NONE;
+                }
+                return add(t.content == "TRUE" || t.content == "FALSE" ? Expr::Literal : Expr::Identifier, t);
+            default:
+                return NONE;
+        }
+    }
+
+    // the opening quote has been read
+    uint32_t parse_quoted(TokenType quote) {
+        Token content(STRING, "");
+        if (peek() != quote) {
+            content = tokens[i++];
+        }
+        return accept(quote) ? add(Expr::Literal, content) : NONE;
+    }
+
+    // the name and the opening parenthesis have been read
+    uint32_t parse_call(const Token& name) {
+        size_t start = pool.pending.size();
+
+        while (peek() != R_PAREN) {
+            if (pool.pending.size() > start && !accept(COMMA)) {
+                return NONE;
+            }
+            uint32_t value = nested(0);
+            if (value == NONE) {
+                return NONE;
+            }
+            pool.pending.push_back({Token(), value});
+        }
+
+        i++;  // ')'
+        return add_operands(Expr::Call, name, start);
+    }
+};
+
+uint32_t ExprPool::add(Expr e, std::span<const Pending> chained) {
+    if (e.kind == Expr::Chain || e.kind == Expr::Call) {
+        e.lhs = static_cast<uint32_t>(operands.size());
+        e.rhs = static_cast<uint32_t>(chained.size());
+        for (const Pending& p : chained) {
+            operands.push_back(p.operand);
+            operators.push_back(p.op);
+        }
+    }
+
+    uint32_t i = size();
+    nodes.push_back(e);
+    return i;
+}
+
+uint32_t ExprPool::parse(std::span<const Token> tokens, size_t max_depth) {
+    size_t start = nodes.size();
+    size_t start_operands = operands.size();
+
+    uint32_t root = Builder(*this, tokens, max_depth).parse();
+    if (root == NONE || root == TOO_DEEP) {
+        nodes.resize(start);
+        operands.resize(start_operands);
+        operators.resize(start_operands);
+    }
+    pending.clear();
+    return root;
+}
+
+// children always come before their parents, so they are copied first
+std::vector<uint32_t> ExprPool::append(const ExprPool& other) {
+    std::vector<uint32_t> copies;
+    copies.reserve(other.size());
+
+    std::vector<Pending> chained;
+    for (Expr e : other.nodes) {
+        chained.clear();
+        if (e.kind == Expr::Chain || e.kind == Expr::Call) {
+            std::span<const uint32_t> children = other.getOperands(e);
+            std::span<const Token> ops = other.getOperators(e);
+            for (size_t k = 0; k < children.size(); k++) {
+                chained.push_back({ops[k], copies[children[k]]});
+            }
+        } else {
+            if (e.lhs != NONE) {
+                e.lhs = copies[e.lhs];
+            }
+            if (e.rhs != NONE) {
+                e.rhs = copies[e.rhs];
+            }
+        }
+        copies.push_back(add(e, chained));
+    }
+    return copies;
+}
+
+void ExprPool::print(Writer& out, uint32_t root) const {
+    // what is left to write, last first: either a node, or the text after one
+    struct Item {
+        uint32_t node;
+        std::string_view text;
+    };
+    std::vector<Item> stack = {{root, {}}};
+
+    while (!stack.empty()) {
+        Item item = stack.back();
+        stack.pop_back();
+        if (item.node == NONE) {
+            out << item.text;
+            continue;
+        }
+
+        const Expr& e = nodes[item.node];
+        switch (e.kind) {
+            case Expr::Identifier:
+                out << e.token.content;
+                break;
+            case Expr::Literal:
+                if (e.token.type == STRING) {
+                    out << '"' << e.token.content << '"';
+                } else if (e.token.type == CHARACTER || e.token.type == ESCAPED_CHARACTER) {
+                    out << '\'' << e.token.content << '\'';
+                } else {
+                    out << e.token.content;
+                }
+                break;
+            case Expr::Unary:
+                out << "(" << e.token.content;
+                stack.push_back({NONE, ")"});
+                stack.push_back({e.lhs, {}});
+                break;
+            case Expr::Binary:
+                out << "(";
+                stack.push_back({NONE, ")"});
+                stack.push_back({e.rhs, {}});
+                stack.push_back({NONE, " "});
+                stack.push_back({NONE, e.token.content});
+                stack.push_back({NONE, " "});
+                stack.push_back({e.lhs, {}});
+                break;
+            case Expr::Index:
+                out << e.token.content << "[";
+                stack.push_back({NONE, "]"});
+                stack.push_back({e.lhs, {}});
+                break;
+            case Expr::Chain: {
+                std::span<const uint32_t> chained = getOperands(e);
+                std::span<const Token> ops = getOperators(e);
+                out << "(";
+                stack.push_back({NONE, ")"});
+                for (size_t k = chained.size() - 1; k > 0; k--) {
+                    stack.push_back({chained[k], {}});
+                    stack.push_back({NONE, " "});
+                    stack.push_back({NONE, ops[k].content});
+                    stack.push_back({NONE, " "});
+                }
+                stack.push_back({chained[0], {}});
+                break;
+            }
+            case Expr::Call: {
+                std::span<const uint32_t> arguments = getOperands(e);
+                out << e.token.content << "(";
+                stack.push_back({NONE, ")"});
+                for (size_t k = arguments.size(); k > 0; k--) {
+                    stack.push_back({arguments[k - 1], {}});
+                    if (k > 1) {
+                        stack.push_back({NONE, ", "});
+                    }
+                }
+                break;
+            }
+        }
+    }
+}
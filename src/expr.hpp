@@ -0,0 +1,131 @@
+/**
+ * @file expr.hpp
+ * @author Hartley Blakey
+ * @brief Precedence-correct trees for the expressions of a program
+ */
+
+#ifndef EXPR_HPP
+#define EXPR_HPP
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tokenize.hpp"
+#include "writer.hpp"
+
+/**
+ * @brief One node of an expression tree. Nodes refer to each other by their index
+ * in the ExprPool that owns them.
+ *
+ * Chains and calls have any number of operands, which are stored next to each other
+ * in the pool. For those, lhs is where they start and rhs is how many there are, see
+ * ExprPool::getOperands()
+ */
+struct Expr {
+    enum Kind : uint8_t {
+        Identifier,  // token is the name
+        Literal,     // token is the integer, character, string, TRUE or FALSE
+        Unary,       // token is the operator, lhs is the operand
+        Binary,      // token is the operator, lhs and rhs are the operands
+        Chain,       // token is the first operator, the operands are folded left to right
+        Index,       // token is the array name, lhs is the index
+        Call,        // token is the function name, the operands are the arguments
+    };
+
+    Kind kind;
+    Token token;
+    uint32_t lhs;
+    uint32_t rhs;
+};
+
+/**
+ * @brief Storage for the nodes of many expression trees, and the precedence climbing
+ * parser that builds them.
+ *
+ * From loosest to tightest, the binary operators are || then && then the relational
+ * operators, then + and -, then *, / and %, then ^. They are all left associative,
+ * except for ^. Unary +, - and ! bind tighter than any binary operator.
+ *
+ * A run of operators with the same precedence, like a + b - c or a && b && c, becomes
+ * a single Chain node. The relational operators and ^ always make Binary nodes.
+ */
+class ExprPool {
+   public:
+    /// @brief Index used for a missing operand
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    /// @brief Returned by parse() instead of a root if the expression is nested too deeply
+    static constexpr uint32_t TOO_DEEP = UINT32_MAX - 1;
+
+    ExprPool() = default;
+
+    /**
+     * @brief Build the tree of one expression, reading each token once. The tokens
+     * are the ones the parser already matched, so this is a pass of its own after it
+     *
+     * @param tokens Every token of the expression, and nothing else
+     * @param max_depth How deeply parentheses, unary operators and ^ may nest. Each
+     * of them counts once, like a rule of the parser, see ParseLimits::max_depth
+     * @return The index of the root, NONE if the tokens are not an expression, or
+     * TOO_DEEP if they nest more than max_depth deep. Nothing is added to the pool in
+     * either of those cases.
+     */
+    uint32_t parse(std::span<const Token> tokens, size_t max_depth);
+
+    /**
+     * @brief Add a copy of every node of other to this pool
+     *
+     * @return The index of the copy of each node of other, by its index in other
+     */
+    std::vector<uint32_t> append(const ExprPool& other);
+
+    const Expr& operator[](uint32_t i) const { return nodes[i]; }
+
+    /**
+     * @brief The operands of a Chain, or the arguments of a Call
+     */
+    std::span<const uint32_t> getOperands(const Expr& e) const {
+        return std::span(operands).subspan(e.lhs, e.rhs);
+    }
+
+    /**
+     * @brief The operators of a Chain. The operator in front of each operand is at
+     * the same position as the operand, so the first one is an UNKNOWN token
+     */
+    std::span<const Token> getOperators(const Expr& e) const {
+        return std::span(operators).subspan(e.lhs, e.rhs);
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(nodes.size()); }
+
+    /**
+     * @brief Print a tree infix, with every operator in parentheses, like
+     * (a < b[2]) or (a + (-b) - f(c, 1)). A chain is one pair of parentheses around
+     * all of its operands
+     */
+    void print(Writer& out, uint32_t root) const;
+
+   private:
+    std::vector<Expr> nodes;
+
+    // the operands of every chain and call, and the operators in front of them
+    std::vector<uint32_t> operands;
+    std::vector<Token> operators;
+
+    // operands of the chains and calls that are still being parsed. Inner ones are
+    // always finished before outer ones, so they are only added to the end
+    struct Pending {
+        Token op;
+        uint32_t operand;
+    };
+    std::vector<Pending> pending;
+
+    // adds a node. Chains and calls take their operands from the given span instead
+    // of lhs and rhs
+    uint32_t add(Expr e, std::span<const Pending> chained = {});
+
+    class Builder;
+};
+
+#endif /* EXPR_HPP */
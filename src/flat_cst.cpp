@@ -0,0 +1,75 @@
+#include "flat_cst.hpp"
+
+#include <utility>
+
+FlatCst::FlatCst(const CstNode* root, std::string_view source) {
+    // siblings still waiting to be visited, with the index of the node that links to them.
+    // only nodes with both a child and a sibling are ever pushed
+    std::vector<std::pair<const CstNode*, uint32_t>> pending;
+    std::vector<std::string_view> contents;
+    auto in_source = [&](std::string_view content) {
+        return content.data() >= source.data() && content.data() + content.size() <= source.data() + source.size();
+    };
+    bool copy = false;
+
+    const CstNode* n = root;
+    while (n || !pending.empty()) {
+        if (!n) {
+            n = pending.back().first;
+            nodes[pending.back().second].sib = static_cast<uint32_t>(nodes.size());
+            pending.pop_back();
+        }
+
+        uint32_t i = static_cast<uint32_t>(nodes.size());
+        nodes.push_back({NONE, NONE});
+        contents.push_back(n->t.content);
+        tokens.push_back({static_cast<uint32_t>(n->t.type), 0, static_cast<uint32_t>(n->t.content.size())});
+        copy = copy || (!n->t.content.empty() && !in_source(n->t.content));
+
+        if (n->sib) {
+            pending.push_back({n->sib, i});
+        }
+
+        if (n->child) {
+            nodes[i].child = i + 1;
+        }
+        n = n->child;
+    }
+
+    // the text of edited definitions goes after a copy of the source
+    std::string_view text = source;
+    if (copy) {
+        copied = source;
+    }
+    for (size_t i = 0; i < tokens.size(); i++) {
+        std::string_view content = contents[i];
+        if (in_source(content)) {
+            tokens[i].offset = static_cast<uint32_t>(content.data() - source.data());
+        } else if (!content.empty()) {
+            tokens[i].offset = static_cast<uint32_t>(copied.size());
+            copied += content;
+        }
+    }
+    if (copy) {
+        text = copied;
+    }
+
+    view = View(nodes, tokens, text);
+}
+
+// same layout as Cst::print(): siblings share a line, each child starts a new one
+void FlatCst::View::print(Writer& out) const {
+    if (size() < 2) {
+        out << "NULL NODE POINTER!!";
+        return;
+    }
+
+    // skip the root, it has no token
+    for (uint32_t i = 1; i < size(); i++) {
+        out << text.substr(tokens[i].offset, tokens[i].length) << (nodes[i].sib == NONE ? "\n" : "   ");
+    }
+}
+
+FlatCst Cst::flatten() const {
+    return FlatCst(*this);
+}
@@ -0,0 +1,155 @@
+/**
+ * @file flat_cst.hpp
+ * @author Hartley Blakey
+ * @brief Index based, preorder layout of a concrete syntax tree
+ */
+
+#ifndef FLAT_CST_HPP
+#define FLAT_CST_HPP
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cst.hpp"
+#include "tokenize.hpp"
+#include "writer.hpp"
+
+/**
+ * @brief A copy of a CstNode tree stored as one contiguous vector of nodes in
+ * preorder (node, child subtree, sibling subtree).
+ *
+ * Nodes refer to each other with 32-bit indices, and the token of a node is at the
+ * same index as the node. A token is its type and the offset and length of its text
+ * in one string, so a node and its token take 20 bytes instead of a 40 byte heap
+ * allocation, and the descendants of any node form one contiguous range of the nodes.
+ *
+ * It is the layout of the tree in a CstFile, written by cst --save and printed by
+ * cst --load. A Cst is still built, printed and walked as CstNode trees, since the
+ * parser links nodes as it goes and Cst::edit() relinks them, so flattening a Cst is
+ * an extra copy that only pays off when the copy is kept.
+ */
+class FlatCst {
+   public:
+    /// @brief Index used for a missing child or sibling
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        uint32_t child;
+        uint32_t sib;
+    };
+
+    struct Token {
+        uint32_t type;
+        uint32_t offset;  // of the text, in View::getText()
+        uint32_t length;
+    };
+
+    class Cursor;
+
+    /**
+     * @brief The nodes, tokens and text of a flat tree, wherever they are stored. A
+     * FlatCst and a CstFile both have one.
+     */
+    class View {
+       public:
+        View() = default;
+        View(std::span<const Node> nodes, std::span<const Token> tokens, std::string_view text)
+            : nodes(nodes), tokens(tokens), text(text) {}
+
+        Cursor getRoot() const { return Cursor(this, nodes.empty() ? NONE : 0, size()); }
+
+        uint32_t size() const { return static_cast<uint32_t>(nodes.size()); }
+
+        std::span<const Node> getNodes() const { return nodes; }
+        std::span<const Token> getTokens() const { return tokens; }
+        std::string_view getText() const { return text; }
+
+        /**
+         * @brief The token of a node. Its text points into getText()
+         */
+        ::Token getToken(uint32_t node) const {
+            const Token& t = tokens[node];
+            return ::Token(static_cast<TokenType>(t.type), text.substr(t.offset, t.length));
+        }
+
+        /**
+         * @brief Print the tree in the same format as Cst::print(), with a single
+         * pass over the nodes
+         */
+        void print(Writer& out) const;
+
+       private:
+        std::span<const Node> nodes;
+        std::span<const Token> tokens;
+        std::string_view text;
+    };
+
+    /**
+     * @brief Lightweight handle to a node, used to navigate the tree the same
+     * way as the child and sib pointers of a CstNode.
+     *
+     * Also tracks the end of the range of nodes the cursor may visit, so the
+     * descendants of the node are the range [index() + 1, end()) when the node
+     * has no sibling, and [index() + 1, sibling().index()) otherwise.
+     */
+    class Cursor {
+        const View* view;
+        uint32_t i;
+        uint32_t last;
+
+       public:
+        Cursor(const View* view, uint32_t i, uint32_t end) : view(view), i(i), last(end) {}
+
+        explicit operator bool() const { return i != NONE; }
+
+        ::Token token() const { return view->getToken(i); }
+
+        Cursor child() const {
+            const Node& n = view->getNodes()[i];
+            return Cursor(view, n.child, n.sib == NONE ? last : n.sib);
+        }
+
+        Cursor sibling() const { return Cursor(view, view->getNodes()[i].sib, last); }
+
+        uint32_t index() const { return i; }
+
+        uint32_t end() const { return last; }
+    };
+
+    /**
+     * @brief Flatten the tree of a finished parse, including its root node. The text
+     * of the tokens stays in the source of the Cst, which has to outlive this, unless
+     * some of them were edited.
+     */
+    explicit FlatCst(const Cst& cst) : FlatCst(cst.getRoot(), cst.getSource()) {}
+
+    /**
+     * @brief Flatten a tree whose tokens may point anywhere. Their text is copied.
+     */
+    explicit FlatCst(const CstNode* root) : FlatCst(root, {}) {}
+
+    // the view points into this
+    FlatCst(const FlatCst&) = delete;
+    FlatCst& operator=(const FlatCst&) = delete;
+
+    const View& getView() const { return view; }
+
+    Cursor getRoot() const { return view.getRoot(); }
+
+    uint32_t size() const { return view.size(); }
+
+    void print(Writer& out) const { view.print(out); }
+
+   private:
+    std::vector<Node> nodes;
+    std::vector<Token> tokens;
+    std::string copied;  // the text, if a token was not in the source
+    View view;
+
+    FlatCst(const CstNode* root, std::string_view source);
+};
+
+#endif /* FLAT_CST_HPP */
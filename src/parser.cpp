@@ -0,0 +1,137 @@
+#include "parser.hpp"
+
+bool isBrace(Token t) {
+    return t.type == L_BRACE || t.type == R_BRACE;
+}
+
+bool ParserBase::is_relational_expression(Token t) {
+    return any(t, LT, GT, LT_EQUAL, GT_EQUAL, BOOLEAN_EQUAL, BOOLEAN_NOT_EQUAL);
+}
+
+bool ParserBase::is_numerical_operator(Token t) {
+    return any(t, PLUS, MINUS, ASTERISK, DIVIDE, MODULO, CARET);
+}
+
+bool ParserBase::is_boolean_operator(Token t) {
+    return any(t, BOOLEAN_AND, BOOLEAN_OR);
+}
+
+bool ParserBase::is_boolean_literal(Token t) {
+    return t.type == IDENTIFIER && any(t, "TRUE", "FALSE");
+}
+
+bool ParserBase::is_datatype_specifier(Token t) {
+    return t.type == IDENTIFIER && any(t, "char", "bool", "int");
+}
+
+bool ParserBase::not_reserved_word(Token t) {
+    return !any(t, is_boolean_literal, is_datatype_specifier, "procedure",
+                "function", "getchar", "printf", "sizeof", "return", "void",
+                "for", "while", "if");
+}
+
+Keyword ParserBase::keyword(const Token& t) {
+    // the text of a string has no quotes in its content, and is never a keyword
+    std::string_view c = t.content;
+    if (t.type != IDENTIFIER || c.empty()) {
+        return Keyword::None;
+    }
+
+    // the first letter and the length are enough to pick the only possible keyword
+    Keyword k = Keyword::None;
+    std::string_view word;
+    switch (c[0]) {
+        case 'i':
+            k = c.size() == 2 ? Keyword::If : Keyword::Int;
+            word = c.size() == 2 ? "if" : "int";
+            break;
+        case 'c':
+            k = Keyword::Char;
+            word = "char";
+            break;
+        case 'b':
+            k = Keyword::Bool;
+            word = "bool";
+            break;
+        case 'p':
+            k = c.size() == 6 ? Keyword::Printf : Keyword::Procedure;
+            word = c.size() == 6 ? "printf" : "procedure";
+            break;
+        case 'f':
+            k = c.size() == 3 ? Keyword::For : Keyword::Function;
+            word = c.size() == 3 ? "for" : "function";
+            break;
+        case 'w':
+            k = Keyword::While;
+            word = "while";
+            break;
+        case 'r':
+            k = Keyword::Return;
+            word = "return";
+            break;
+        case 'g':
+            k = Keyword::Getchar;
+            word = "getchar";
+            break;
+        case 's':
+            k = Keyword::Sizeof;
+            word = "sizeof";
+            break;
+    }
+    return c == word ? k : Keyword::None;
+}
+
+std::string checkSyntax(Tokenizer* tk, ParseLimits limits, ParseStatus* status) {
+    ParseHandler ignore;
+    Parser<ParseHandler> parser(tk, ignore, limits);
+    parser.parse();
+    if (status) {
+        *status = parser.getStatus();
+    }
+    return parser.getError();
+}
+
+std::vector<Diagnostic> findSyntaxErrors(Tokenizer* tk, ParseLimits limits, ParseStatus* status) {
+    ParseHandler ignore;
+    Parser<ParseHandler> parser(tk, ignore, limits);
+    parser.parse();
+    if (status) {
+        *status = parser.getStatus();
+    }
+    return parser.getDiagnostics();
+}
+
+const char* ruleName(Rule r) {
+    switch (r) {
+        case Rule::Program: return "program";
+        case Rule::Main: return "main";
+        case Rule::ProgramTail: return "program tail";
+        case Rule::Procedure: return "procedure";
+        case Rule::Function: return "function";
+        case Rule::Parameters: return "parameters";
+        case Rule::Block: return "block";
+        case Rule::Compound: return "compound statement";
+        case Rule::Statement: return "statement";
+        case Rule::Return: return "return";
+        case Rule::Declaration: return "declaration";
+        case Rule::Call: return "call";
+        case Rule::CallStatement: return "call statement";
+        case Rule::Sizeof: return "sizeof";
+        case Rule::Getchar: return "getchar";
+        case Rule::Printf: return "printf";
+        case Rule::Assignment: return "assignment";
+        case Rule::Iteration: return "iteration";
+        case Rule::Selection: return "selection";
+        case Rule::IterationAssignment: return "iteration assignment";
+        case Rule::Expression: return "expression";
+        case Rule::Initialization: return "initialization";
+        case Rule::BooleanExpression: return "boolean expression";
+        case Rule::NumericalExpression: return "numerical expression";
+        case Rule::RelationalExpression: return "relational expression";
+        case Rule::NumericalOperand: return "numerical operand";
+        case Rule::IdentifierAndIdentArrParamList: return "identifier and identifier array parameter list";
+        case Rule::IdentifierAndIdentArrList: return "identifier and identifier array list";
+        case Rule::ParameterDecl: return "parameter declaration";
+    }
+    return "unknown";
+}
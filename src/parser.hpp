@@ -0,0 +1,1767 @@
+/**
+ * @file parser.hpp
+ * @author Hartley Blakey
+ * @brief Recursive descent parser for ChagaLite that reports what it parses to an
+ * event handler chosen at compile time, instead of building a tree itself
+ */
+
+#ifndef PARSER_HPP
+#define PARSER_HPP
+
+#include <algorithm>
+#include <cassert>
+#include <format>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cst.hpp"
+#include "tokenize.hpp"
+
+#ifdef DEBUG
+#define DEBUG_PRINT(s) std::cout << s << " in " << __func__ << " seeing " << t.content << " --> " << tk->peek().content << " on line " << tk->getLine() << "\n";
+#else
+#define DEBUG_PRINT(s)
+#endif
+
+/**
+ * @brief The grammar rules of the parser, one per parse_* function
+ */
+enum class Rule {
+    Program,
+    Main,
+    ProgramTail,
+    Procedure,
+    Function,
+    Parameters,
+    Block,
+    Compound,
+    Statement,
+    Return,
+    Declaration,
+    Call,
+    CallStatement,
+    Sizeof,
+    Getchar,
+    Printf,
+    Assignment,
+    Iteration,
+    Selection,
+    IterationAssignment,
+    Expression,
+    Initialization,
+    BooleanExpression,
+    NumericalExpression,
+    RelationalExpression,
+    NumericalOperand,
+    IdentifierAndIdentArrParamList,
+    IdentifierAndIdentArrList,
+    ParameterDecl,
+};
+
+const char* ruleName(Rule r);
+
+/**
+ * @brief The words that decide which statement or definition rule can match a token
+ */
+enum class Keyword : uint8_t {
+    None,
+    Int,
+    Char,
+    Bool,
+    Printf,
+    If,
+    For,
+    While,
+    Return,
+    Getchar,
+    Sizeof,
+    Procedure,
+    Function,
+};
+
+/**
+ * @brief Handler that ignores every parse event. Handlers passed to Parser inherit
+ * from this and hide the events they are interested in.
+ *
+ * enter() and exit() bracket every rule. Rules that can reject the current token with
+ * a cheap check (a keyword, a token type) only fire once that check has passed, while
+ * the statement, expression and operand rules fire on every attempt, even if they then
+ * match nothing. Every consumed token is reported through child() or sibling(), in the
+ * position it would have in the CST, and declarations are reported as they are parsed.
+ */
+struct ParseHandler {
+    using Datatype = SymbolTable::VariableType;
+
+    // Set to true by handlers that only care about declarations. The statements of
+    // function bodies are then skimmed with brace matching, and only the declarations
+    // among them are parsed, so syntax errors in other statements go unnoticed.
+    static constexpr bool skim_bodies = false;
+
+    // Set to true by handlers that want function and procedure bodies left for later.
+    // The braces of the body are still reported, but the tokens between them are
+    // skipped by brace matching, and deferred_body() is called right after the
+    // opening brace with the line it is on. See Parser::parseBody()
+    static constexpr bool lazy_bodies = false;
+
+    void enter(Rule) {}
+    void exit(Rule) {}
+
+    void child(const Token&) {}
+    void sibling(const Token&) {}
+
+    void enter_function(std::string_view, std::optional<Datatype>) {}
+    void add_param(std::string_view, Datatype) {}
+    void add_var(std::string_view, Datatype) {}
+    void exit_function() {}
+
+    void deferred_body(const Token&, size_t) {}
+
+    // Checked after each exit(). A handler that builds its own nested structures returns
+    // true once they got deeper than ParseLimits::max_depth, and the parse then stops
+    // with ParseStatus::TooDeep as if a rule had
+    bool too_deep() const { return false; }
+};
+
+/**
+ * @brief Check a program for syntax errors without building a tree or a symbol
+ * table. Runs the same parser as Cst, with a handler that ignores every event.
+ *
+ * @param tk The tokenizer for the program
+ * @return The first syntax error, in the same format as Cst::getError(), or the
+ * empty string if the program is valid
+ */
+std::string checkSyntax(Tokenizer* tk, ParseLimits limits = {}, ParseStatus* status = nullptr);
+
+/**
+ * @brief Like checkSyntax(), but keep parsing after each syntax error to find the
+ * ones after it too
+ *
+ * @return Every syntax error, in the order of the file. Empty if the program is valid
+ */
+std::vector<Diagnostic> findSyntaxErrors(Tokenizer* tk, ParseLimits limits = {}, ParseStatus* status = nullptr);
+
+/**
+ * @brief The parts of the parser that don't depend on the handler
+ */
+class ParserBase {
+   public:
+    using Datatype = SymbolTable::VariableType;
+
+    /**
+     * @brief How many rules may be nested inside each other before the parse stops
+     * with a syntax error by default, so that deeply nested programs can't overflow
+     * the native stack. Operator chains and lists are parsed in loops and don't count
+     * towards it.
+     */
+    static constexpr size_t MAX_DEPTH = ParseLimits::DEFAULT_MAX_DEPTH;
+
+    static bool is_relational_expression(Token t);
+    static bool is_numerical_operator(Token t);
+    static bool is_boolean_operator(Token t);
+    static bool is_boolean_literal(Token t);
+    static bool is_datatype_specifier(Token t);
+    static bool not_reserved_word(Token t);
+
+    /**
+     * @brief Classify an identifier by its content alone, with a single comparison.
+     * Any other token, like a string with the same text, is Keyword::None
+     */
+    static Keyword keyword(const Token& t);
+    static Datatype to_datatype(Token t) {
+        if (t.content == "int") {
+            return Datatype::Int;
+        } else if (t.content == "bool") {
+            return Datatype::Bool;
+        } else if (t.content == "char") {
+            return Datatype::Char;
+        } else {
+            assert(false);
+        }
+    }
+
+   protected:
+    static bool any(const Token& t, TokenType aType) {
+        return t.type == aType;
+    }
+
+    static bool any(const Token& t, const char* aContent) {
+        return t.content == aContent;
+    }
+
+    static bool any(const Token& t, bool (*aTest)(Token)) {
+        return aTest(t);
+    }
+
+    /**
+     * @brief Helper to test if a token matches either a TokenType,
+     * token content string, or predicate function
+     */
+    template <typename... Args>
+    static bool any(const Token& t, Args... args) {
+        return (any(t, args) || ...);
+    }
+};
+
+/**
+ * @brief Parser for a whole ChagaLite program.
+ *
+ * Everything it parses is reported to the handler as it happens (see ParseHandler),
+ * and the calls are resolved at compile time, so a handler that ignores every event
+ * leaves a plain recognizer.
+ *
+ * @tparam Handler A class derived from ParseHandler
+ */
+template <typename Handler>
+class Parser : public ParserBase {
+   public:
+    Parser() = delete;
+    Parser(Tokenizer* tk, Handler& h, ParseLimits limits = {}) : h(h), limits(limits) {
+        this->tk = tk;
+        error = {};
+        t = Token(UNKNOWN);
+        node_budget = std::min(limits.max_nodes, limits.max_bytes / sizeof(CstNode));
+    }
+
+    /**
+     * @brief Parse the rest of the token stream as a program
+     *
+     * @return true if no syntax error was found
+     */
+    bool parse() {
+        t = tk->next();
+        parse_program();
+        return ok();
+    }
+
+    /**
+     * @brief Parse the statements of a block whose opening brace has already been
+     * consumed, like a body left for later by a handler with lazy_bodies. The
+     * tokenizer should start right after the opening brace.
+     *
+     * @return true if no syntax error was found before the closing brace
+     */
+    bool parseBody() {
+        t = tk->next();
+        parse_compound();
+        expect(R_BRACE);
+        return ok();
+    }
+
+    /**
+     * @brief Parse the rest of the token stream as exactly one function, procedure or
+     * global declaration, like one that is being parsed again after an edit
+     *
+     * @return true if no syntax error was found
+     */
+    bool parseDefinition() {
+        t = tk->next();
+        bool found = (keyword(t) == Keyword::Procedure && parse_main()) || parse_definition();
+        if (!found) {
+            syntaxError("Expected a function, procedure or declaration");
+        }
+        expect(END, "There should be nothing after the end of the definition");
+        return ok();
+    }
+
+    std::string getError() { return error; }
+    bool ok() { return error.empty(); }
+
+    /**
+     * @brief Every syntax error found, in the order they were found. The parser
+     * recovers from an error by skipping to the end of the statement or block, or
+     * to the next definition, so each of them is reported separately. getError()
+     * is the first of them.
+     */
+    const std::vector<Diagnostic>& getDiagnostics() { return diagnostics; }
+
+    ParseStatus getStatus() {
+        if (limit != ParseStatus::Ok) {
+            return limit;
+        }
+        return ok() ? ParseStatus::Ok : ParseStatus::SyntaxError;
+    }
+
+   private:
+    Token t;
+    Tokenizer* tk;
+    Handler& h;
+
+    std::string error;
+    std::vector<Diagnostic> diagnostics;
+
+    // set by a syntax error until the parser has skipped to a place it can continue
+    // from. Any other syntax error found in the meantime is a consequence of the
+    // first one, and isn't reported
+    bool panicking = false;
+
+    TokenType last = UNKNOWN;  // of the last token added to the tree
+
+    size_t depth = 0;
+    bool halted = false;
+
+    ParseLimits limits;
+    size_t nodes = 0;
+    size_t node_budget;
+    ParseStatus limit = ParseStatus::Ok;
+
+    /**
+     * @brief Reports entering a rule to the handler, and exiting it when the scope ends.
+     * Also stops the parse if the rules are nested too deeply
+     */
+    struct RuleScope {
+        Parser* p;
+        Rule r;
+
+        RuleScope(Parser* p, Rule r) : p(p), r(r) {
+            p->h.enter(r);
+            if (++p->depth > p->limits.max_depth && !p->halted) {
+                p->stop(ParseStatus::TooDeep, "program is nested too deeply (more than {} rules)", p->limits.max_depth);
+            }
+        }
+        ~RuleScope() {
+            p->depth--;
+            p->h.exit(r);
+            if (p->h.too_deep() && !p->halted) {
+                p->stop(ParseStatus::TooDeep, "expression is nested too deeply (more than {} levels)", p->limits.max_depth);
+            }
+        }
+    };
+
+    // makes every rule that is still running see the end of the file, so they all
+    // return without reading or reporting any more tokens
+    void halt() {
+        halted = true;
+        t = Token(END);
+    }
+
+    // reports the limit even while panicking, since the parse can't go on after it
+    template <typename... Args>
+    void stop(ParseStatus reason, std::format_string<Args...> fmt, Args&&... args) {
+        panicking = false;
+        syntaxError(fmt, std::forward<Args>(args)...);
+        limit = reason;
+        halt();
+    }
+
+    // counts the node the handler is about to add for t. False if the parse was
+    // stopped because that is one too many, or it ran out of time
+    bool count_node() {
+        if (++nodes > node_budget) {
+            if (nodes > limits.max_nodes) {
+                stop(ParseStatus::TooManyNodes, "program has more than {} nodes", limits.max_nodes);
+            } else {
+                stop(ParseStatus::TooManyBytes, "program needs more than {} bytes of nodes", limits.max_bytes);
+            }
+            return false;
+        }
+        if (limits.deadline && nodes % ParseLimits::DEADLINE_INTERVAL == 0 &&
+            std::chrono::steady_clock::now() > *limits.deadline) {
+            stop(ParseStatus::TimedOut, "program took too long to parse");
+            return false;
+        }
+        return true;
+    }
+
+    void advance_child() {
+        if (halted || !count_node()) {
+            return;
+        }
+        h.child(t);
+        last = t.type;
+        t = tk->next();
+    }
+
+    void advance_sibling() {
+        if (halted || !count_node()) {
+            return;
+        }
+        h.sibling(t);
+        last = t.type;
+        t = tk->next();
+    }
+
+    // a token of the wrong type is left for the recovery to resync on, even while
+    // panicking, so a missing ';' can't swallow the keyword of the next definition
+    void expect_child(TokenType type) {
+        if (expect(type) || t.type == type) {
+            advance_child();
+        }
+    }
+
+    void expect_sibling(TokenType type) {
+        if (expect(type) || t.type == type) {
+            advance_sibling();
+        }
+    }
+
+    bool parse_program();
+    bool parse_main();
+    bool parse_program_tail();
+    bool parse_definition();
+    bool parse_procedure();
+    bool parse_function();
+    bool parse_parameters();
+    bool parse_block();
+    bool parse_compound();
+    bool skim_compound();
+    bool defer_body();
+    void skip_block();
+    bool parse_statement();
+    bool parse_return();
+    bool parse_declaration();
+    bool parse_call();
+    bool parse_call_statement();
+    bool parse_sizeof();
+    bool parse_getchar();
+    bool parse_printf();
+    bool parse_assignment();
+    bool parse_iteration();
+    bool parse_selection();
+    bool parse_iteration_assignment();
+    bool parse_expression();
+    bool parse_initialization();
+    bool parse_boolean_expression();
+    bool parse_numerical_expression();
+    bool parse_relational_expression();
+    bool parse_numerical_operand();
+    bool parse_identifier_and_ident_arr_param_list();
+    bool parse_identifier_and_ident_arr_list();
+    bool parse_parameter_decl();
+
+    bool in_boolean_prefix();
+
+    /**
+     * @brief Emit a formatted syntax error. If this is called twice, only the
+     * first will be recorded in the error string.
+     *
+     * Arguments are forwards to std::format() for the error message.
+     *
+     * Automatically prints the line number, and the line itself if DEBUG is defined
+     */
+    template <typename... Args>
+    void syntaxError(std::format_string<Args...> fmt, Args&&... args) {
+        if (panicking) {
+            return;
+        }
+        panicking = true;
+
+        diagnostics.push_back({tk->getLine(), std::format(fmt, std::forward<Args>(args)...)});
+        if (!ok()) {
+            return;
+        }
+
+#ifdef DEBUG
+        // show extra context in debug
+        error = std::format("Syntax error on line {}: {}\n{}",
+                            tk->getLine(),
+                            diagnostics.back().message,
+                            tk->getLineDebug());
+
+#else
+        error = std::format("Syntax error on line {}: {}",
+                            tk->getLine(),
+                            diagnostics.back().message);
+
+#endif
+    }
+
+    bool recover_statement();
+    void recover_definition();
+    void parse_definition_or_recover();
+
+    /**
+     * @brief Expect the current token to match the pattern, which can be a
+     * token type enum, a string to check against the token content, or a
+     * predicate function to call on the current token.
+     *
+     * If the token does not match, emit a formatted syntax error
+     *
+     * @tparam T either TokenType, const char*, or a Token --> bool function
+     * @tparam Args The type arguments to std::format
+     * @param expected The patten to expect
+     * @param fmt The format string for the syntax error
+     * @param args The value arguments to std::format
+     * @return true if the token matched
+     * @return false if the token did not match
+     */
+    template <typename T, typename... Args>
+    bool expect(T expected, std::format_string<Args...> fmt, Args&&... args) {
+        if (panicking) {
+            return false;
+        }
+        if (!any(t, expected)) {
+            syntaxError(fmt, std::forward<Args>(args)...);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Expect the current token to match the given token type or content
+     * Otherwise, emit a syntax error with the current line number.
+     *
+     * @tparam T either TokenType or const char*
+     * @param expected the expected token type or content string
+     * @return true if the current token matches
+     * @return false otherwise
+     */
+    template <typename T>
+    bool expect(T expected) {
+        if (panicking) {
+            return false;
+        }
+        if (!any(t, expected)) {
+            syntaxError("Expected {}, got \"{}\" ({})", expected, t.content, t.type);
+            return false;
+        }
+        return true;
+    }
+};
+
+template <typename Handler>
+bool Parser<Handler>::in_boolean_prefix() {
+    Token x = t.type == L_PAREN ? tk->peek() : t;
+    return is_boolean_literal(x) || x.type == BOOLEAN_NOT || is_boolean_operator(x);
+}
+
+// L_BRACE> <COMPOUND_STATEMENT> <R_BRACE> | <L_BRACE> <R_BRACE>
+template <typename Handler>
+bool Parser<Handler>::parse_block() {
+    if (t.type != L_BRACE) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Block);
+    advance_child();
+
+    parse_compound();
+
+    expect_child(R_BRACE);
+
+    return true;
+}
+
+/*
+return <EXPRESSION> <SEMICOLON>
+return <SINGLE_QUOTED_STRING> <SEMICOLON>
+return <DOUBLE_QUOTED_STRING> <SEMICOLON>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_return() {
+    if (t.type != IDENTIFIER || t.content != "return") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Return);
+    advance_child();
+
+    if (!parse_expression()) {
+        if (t.type != SINGLE_QUOTE && t.type != DOUBLE_QUOTE) {
+            syntaxError("Functions can only return expressions or strings");
+        }
+        TokenType quoteType = t.type;
+        advance_sibling();
+        expect_sibling(STRING);
+        expect_sibling(quoteType);
+    }
+    expect_sibling(SEMICOLON);
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_declaration() {
+    if (!is_datatype_specifier(t) || tk->peek().type != IDENTIFIER) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Declaration);
+
+    h.add_var(tk->peek().content, to_datatype(t));
+
+    advance_child();  // data type
+    if (!parse_identifier_and_ident_arr_list()) {
+        syntaxError("empty declarations not allowed");
+    }
+    expect_sibling(SEMICOLON);
+
+    return true;
+}
+
+/*
+<IDENTIFIER> <L_PAREN> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN>
+<IDENTIFIER> <L_PAREN> <EXPRESSION> <R_PAREN>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_call() {
+    if (t.type != IDENTIFIER || tk->peek().type != L_PAREN) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Call);
+
+    advance_sibling();
+    advance_sibling();
+
+    if (!parse_identifier_and_ident_arr_param_list() && !parse_expression()) {
+        syntaxError("Expected param list or expression in function call");
+    }
+
+    expect_sibling(R_PAREN);
+
+    return true;
+}
+
+/*
+<IDENTIFIER> <L_PAREN> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN>
+<IDENTIFIER> <L_PAREN> <EXPRESSION> <R_PAREN>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_call_statement() {
+    if (t.type != IDENTIFIER || tk->peek().type != L_PAREN) {
+        return false;
+    }
+    RuleScope scope(this, Rule::CallStatement);
+    advance_child();
+    advance_sibling();
+    parse_identifier_and_ident_arr_param_list() || parse_expression();
+    expect_sibling(R_PAREN);
+    expect_sibling(SEMICOLON);
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_sizeof() {
+    if (t.type != IDENTIFIER || t.content != "sizeof") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Sizeof);
+    advance_child();
+    expect_sibling(L_PAREN);
+    expect_sibling(IDENTIFIER);
+    expect_sibling(R_PAREN);
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_getchar() {
+    if (t.type != IDENTIFIER || t.content != "getchar") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Getchar);
+    advance_child();
+    expect_sibling(L_PAREN);
+    expect("void", "getchar must be called with argument 'void'");
+    expect_sibling(IDENTIFIER);
+    expect_sibling(R_PAREN);
+    return true;
+}
+
+/*
+printf <L_PAREN> <DOUBLE_QUOTED_STRING> <R_PAREN> <SEMICOLON>
+printf <L_PAREN> <SINGLE_QUOTED_STRING> <R_PAREN> <SEMICOLON>
+printf <L_PAREN> <DOUBLE_QUOTED_STRING> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN> <SEMICOLON>
+printf <L_PAREN> <SINGLE_QUOTED_STRING> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST> <R_PAREN> <SEMICOLON>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_printf() {
+    if (t.type != IDENTIFIER || t.content != "printf") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Printf);
+
+    advance_child();  // printf
+    expect_sibling(L_PAREN);
+
+    if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == STRING) {
+        auto quoteType = t.type;
+        advance_sibling();          // quote
+        advance_sibling();          // string
+        expect_sibling(quoteType);  // end quote
+    } else {
+        syntaxError("printf statement must have a format string");
+    }
+
+    if (t.type == COMMA) {
+        advance_sibling();
+        parse_identifier_and_ident_arr_param_list();
+    }
+
+    expect_sibling(R_PAREN);
+    expect_sibling(SEMICOLON);
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_assignment() {
+    if (t.type != IDENTIFIER || is_datatype_specifier(t)) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Assignment);
+
+    expect(not_reserved_word, "Cannot assign to reserved word {}", t.content);
+    advance_child();
+
+    if (t.type == L_BRACKET) {
+        advance_sibling();
+
+        if (!parse_numerical_expression()) {
+            syntaxError("Invalid array index");
+        }
+        expect_sibling(R_BRACKET);
+    }
+
+    expect_sibling(ASSIGNMENT_OPERATOR);
+    if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == STRING) {
+        auto quoteType = t.type;
+        advance_sibling();          // quote
+        advance_sibling();          // string
+        expect_sibling(quoteType);  // end quote
+    } else if (parse_expression()) {
+        // already done here
+    } else if (t.type == IDENTIFIER) {
+        expect(not_reserved_word, "attempted to take value of reserved word {}", t.content);
+        advance_sibling();
+    } else if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == ESCAPED_CHARACTER) {
+        auto quoteType = t.type;
+        advance_sibling();          // quote
+        advance_sibling();          // escaped char
+        expect_sibling(quoteType);  // end quote
+    } else {
+        syntaxError("invalid assignment");
+    }
+
+    expect_sibling(SEMICOLON);
+
+    return true;
+}
+
+/*
+for     <L_PAREN> <INITIALIZATION_EXPRESSION> <SEMICOLON> <BOOLEAN_EXPRESSION> <SEMICOLON> <ITERATION_ASSIGNMENT> <R_PAREN> <STATEMENT>
+for     <L_PAREN> <INITIALIZATION_EXPRESSION> <SEMICOLON> <BOOLEAN_EXPRESSION> <SEMICOLON> <ITERATION_ASSIGNMENT> <R_PAREN> <BLOCK_STATEMENT>
+while   <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT>
+while   <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_iteration() {
+    if (t.type != IDENTIFIER || (t.content != "for" && t.content != "while")) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Iteration);
+
+    if (t.content == "for") {
+        advance_child();
+        expect_sibling(L_PAREN);
+        parse_initialization();
+        expect_sibling(SEMICOLON);
+        if (!parse_boolean_expression()) {
+            syntaxError("Expected boolean expression in for loop condition");
+        }
+        expect_sibling(SEMICOLON);
+        parse_iteration_assignment();
+        expect_sibling(R_PAREN);
+        if (!parse_block() && !parse_statement()) {
+            syntaxError("Expected expression or block after for loop");
+        }
+    } else if (t.content == "while") {
+        advance_child();
+        expect_sibling(L_PAREN);
+        parse_boolean_expression();
+        expect_sibling(R_PAREN);
+        if (!parse_block() && !parse_statement()) {
+            syntaxError("Expected expression or block after while loop");
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/*
+if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT> |
+if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT> |
+
+if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT> else <STATEMENT> |
+if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <STATEMENT> else <BLOCK_STATEMENT>
+
+if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT> else <STATEMENT> |
+if <L_PAREN> <BOOLEAN_EXPRESSION> <R_PAREN> <BLOCK_STATEMENT> else <BLOCK_STATEMENT> |
+
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_selection() {
+    if (t.type != IDENTIFIER || t.content != "if") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Selection);
+
+    advance_child();
+    expect_sibling(L_PAREN);
+
+    if (!parse_boolean_expression()) {
+        syntaxError("Expected boolean expression in 'if' statement");
+    }
+
+    expect_sibling(R_PAREN);
+
+    if (!parse_block() && !parse_statement()) {
+        syntaxError("Expected statement in 'if' block");
+    }
+
+    if (t.type != IDENTIFIER || t.content != "else") {
+        return true;
+    }
+
+    advance_child();  // else
+
+    if (!parse_block() && !parse_statement()) {
+        syntaxError("Expected statement in 'else' block");
+    }
+
+    return true;
+}
+
+/*
+<IDENTIFIER> <ASSIGNMENT_OPERATOR> <EXPRESSION>
+<IDENTIFIER> <ASSIGNMENT_OPERATOR> <SINGLE_QUOTED_STRING>
+<IDENTIFIER> <ASSIGNMENT_OPERATOR> <DOUBLE_QUOTED_STRING>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_iteration_assignment() {
+    RuleScope scope(this, Rule::IterationAssignment);
+    return parse_initialization();
+}
+
+/*
+<IDENTIFIER> <ASSIGNMENT_OPERATOR> <EXPRESSION>
+<IDENTIFIER> <ASSIGNMENT_OPERATOR> <SINGLE_QUOTED_STRING>
+<IDENTIFIER> <ASSIGNMENT_OPERATOR> <DOUBLE_QUOTED_STRING>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_initialization() {
+    if (t.type != IDENTIFIER || tk->peek().type != ASSIGNMENT_OPERATOR) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Initialization);
+
+    advance_sibling();
+    advance_sibling();
+
+    if (!parse_expression()) {
+        if ((t.type == SINGLE_QUOTE || t.type == DOUBLE_QUOTE) && tk->peek().type == STRING) {
+            TokenType quoteType = t.type;
+            advance_sibling();          // quote
+            advance_sibling();          // string
+            expect_sibling(quoteType);  // end quote
+        } else {
+            syntaxError("iteration assignment value must be string or expression");
+        }
+    }
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_expression() {
+    RuleScope scope(this, Rule::Expression);
+    // we need to strip the parenthesis since (x + y) and (x + y < 4) dead end
+    //     if you try to parse the first as boolean or the second as numeric
+    bool parenthesised = false;
+    if (t.type == L_PAREN) {
+        parenthesised = true;
+        advance_sibling();  // '('
+    }
+
+    // potential shared prefix
+    if (parse_numerical_expression()) {
+        if (parenthesised && t.type == R_PAREN) {
+            advance_sibling();
+            parenthesised = false;
+        }
+        if (parse_relational_expression()) {
+            if (!parse_numerical_expression()) {
+                syntaxError("Expected numerical expression on rhs of relational operator");
+            }
+            if (parenthesised && t.type == R_PAREN) {
+                advance_sibling();
+                parenthesised = false;
+            }
+            // <num expr> <rel op> <num expr>
+            if (is_boolean_operator(t)) {
+                if (!parse_boolean_expression()) {
+                    syntaxError("Expected boolean expression after boolean operator");
+                }
+                // <num expr> <rel op> <num expr> <bool op> <bool expr>
+            }
+        }
+        if (parenthesised) {
+            expect_sibling(R_PAREN);
+        }
+    } else {
+        if (!parenthesised) {
+            return parse_boolean_expression();
+        }
+        if (!parse_boolean_expression()) {
+            syntaxError("Expected expression in parenthesis");
+        }
+        expect_sibling(R_PAREN);
+
+        if (is_boolean_operator(t)) {
+            advance_sibling();
+            if (!parse_boolean_expression()) {
+                syntaxError("Expected boolean expression after boolean operator");
+            }
+        }
+    }
+
+    return true;
+}
+
+/*
+                        <NUMERICAL_OPERAND> |
+<L_PAREN> 				<NUMERICAL_OPERAND> 	<R_PAREN> |
+                        <NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> |
+<L_PAREN> 				<NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> <R_PAREN> |
+                        <NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	<L_PAREN> 		<NUMERICAL_EXPRESSION> <R_PAREN> <NUMERICAL_OPERATOR> <NUMERICAL_EXPRESSION> |
+<L_PAREN> 				<NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> <R_PAREN> |
+                        <NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	<L_PAREN> 		<NUMERICAL_EXPRESSION> <R_PAREN> |
+<L_PAREN> 				<NUMERICAL_OPERAND> 	<NUMERICAL_OPERATOR> 	                <NUMERICAL_EXPRESSION> <R_PAREN> <NUMERICAL_OPERATOR> <NUMERICAL_EXPRESSION> |
+                        <NUMERICAL_OPERATOR> 	<NUMERICAL_EXPRESSION>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_numerical_expression() {
+    if (in_boolean_prefix()) {
+        return false;
+    }
+    RuleScope scope(this, Rule::NumericalExpression);
+
+    // A <NUMERICAL_EXPRESSION> at the end of this one is parsed by going around the loop
+    // again instead of recursing, so operator chains don't grow the native stack. missing
+    // is the error to report if it isn't there. waiting counts the expressions that are
+    // done except for an optional <NUMERICAL_OPERATOR> <NUMERICAL_EXPRESSION> after the
+    // one being parsed
+    const char* missing = nullptr;
+    size_t waiting = 0;
+
+    while (true) {
+        if (missing && in_boolean_prefix()) {
+            syntaxError("{}", missing);
+            return true;
+        }
+
+        if (is_numerical_operator(t)) {
+            advance_sibling();
+            missing = "Expected numerical expression after numerical operator";
+            continue;
+        }
+
+        bool expecting_parenthesis = false;
+        if (t.type == L_PAREN) {
+            expecting_parenthesis = true;
+            advance_sibling();
+        }
+
+        if (!parse_numerical_operand()) {
+            if (expecting_parenthesis) {
+                syntaxError("Expected numerical operand in numerical expression");
+            } else if (missing) {
+                syntaxError("{}", missing);
+            } else {
+                return false;
+            }
+            return true;
+        }
+
+        if (t.type == R_PAREN) {
+            if (expecting_parenthesis) {
+                advance_sibling();
+            }
+
+        } else if (!is_numerical_operator(t)) {
+            if (expecting_parenthesis) {
+                syntaxError("failed to find closing parenthesis in numerical expression");
+                return true;
+            }
+            // just a single operand
+
+        } else {
+            advance_sibling();
+
+            if (t.type == L_PAREN) {
+                if (expecting_parenthesis) {
+                    syntaxError("Unexpected L_PAREN");
+                }
+                expecting_parenthesis = true;
+                advance_sibling();
+            }
+
+            if (!expecting_parenthesis) {
+                waiting++;
+                missing = "Expected numerical expression";
+                continue;
+            }
+
+            if (!parse_numerical_expression()) {
+                syntaxError("Expected numerical expression");
+            }
+            expect_sibling(R_PAREN);
+
+            if (is_numerical_operator(t)) {
+                advance_sibling();
+                missing = "Expected numerical expression";
+                continue;
+            }
+        }
+
+        if (waiting > 0 && is_numerical_operator(t)) {
+            waiting--;
+            advance_sibling();
+            missing = "Expected numerical expression";
+            continue;
+        }
+        return true;
+    }
+}
+
+/*
+<BOOLEAN_TRUE> | <BOOLEAN_FALSE> | <IDENTIFIER> |
+<IDENTIFIER> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
+<BOOLEAN_NOT> <BOOLEAN_TRUE> |
+<BOOLEAN_NOT> <BOOLEAN_FALSE> |
+<BOOLEAN_NOT> <IDENTIFIER> |
+<USER_DEFINED_FUNCTION> |
+<USER_DEFINED_FUNCTION> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
+<BOOLEAN_NOT> <USER_DEFINED_FUNCTION> |
+<L_PAREN> <USER_DEFINED_FUNCTION> <R_PAREN> |
+<L_PAREN> <IDENTIFIER> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> <R_PAREN> |
+<NUMERICAL_EXPRESSION> <RELATIONAL_EXPRESSION> <NUMERICAL_EXPRESSION> |
+<L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN> |
+<L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
+<L_PAREN> <BOOLEAN_NOT> <IDENTIFIER> <R_PAREN> |
+<L_PAREN> <BOOLEAN_NOT> <IDENTIFIER> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> <R_PAREN> |
+<L_PAREN> <BOOLEAN_NOT> <USER_DEFINED_FUNCTION> <R_PAREN> |
+<L_PAREN> <BOOLEAN_NOT> <USER_DEFINED_FUNCTION> <R_PAREN> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION> |
+<L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_EXPRESSION> <R_PAREN>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_boolean_expression() {
+    if (t.type == INTEGER && !is_relational_expression(tk->peek())) {
+        return false;
+    }
+    RuleScope scope(this, Rule::BooleanExpression);
+
+    // A <BOOLEAN_EXPRESSION> after a <BOOLEAN_OPERATOR> at the end of this one is parsed
+    // by going around the loop again instead of recursing, like the operator chains of
+    // parse_numerical_expression(). chained is set once one has been, missing is the
+    // error to report if the next one isn't there, and closing counts the R_PARENs that
+    // are expected after the end of the chain
+    bool chained = false;
+    const char* missing = nullptr;
+    size_t closing = 0;
+
+    auto finish = [&](bool matched) {
+        if (!matched && missing) {
+            syntaxError("{}", missing);
+        }
+        for (; closing > 0; closing--) {
+            expect_sibling(R_PAREN);
+        }
+        return matched || chained;
+    };
+
+    while (true) {
+        bool parenthesized = false;
+
+        if (chained && t.type == INTEGER && !is_relational_expression(tk->peek())) {
+            return finish(false);
+        }
+
+        if (t.type == L_PAREN && tk->peek().type == IDENTIFIER) {
+            parenthesized = true;
+            advance_sibling();
+
+            if (is_boolean_operator(tk->peek())) {
+                advance_sibling();
+                parse_boolean_expression();
+                expect_sibling(R_PAREN);
+                return finish(true);
+            } else if (parse_call()) {
+                expect_sibling(R_PAREN);
+                return finish(true);
+            }
+        }
+
+        if (parenthesized && t.type == IDENTIFIER && is_relational_expression(tk->peek())) {
+            // parse as
+            // <L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN>
+            // <L_PAREN> <NUMERICAL_OPERAND> <RELATIONAL_EXPRESSION> <NUMERICAL_OPERAND> <R_PAREN> <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION>
+
+            parse_numerical_operand();
+            parse_relational_expression();
+            parse_numerical_operand();
+
+            expect_sibling(R_PAREN);
+
+            if (is_boolean_operator(t)) {
+                advance_sibling();
+                chained = true;
+                missing = nullptr;
+                continue;
+            }
+
+            return finish(true);
+        }
+
+        if (parse_numerical_expression()) {
+            if (parenthesized && t.type == R_PAREN) {
+                advance_sibling();
+                parenthesized = false;
+            }
+            expect(is_relational_expression, "Expected relational operator after numerical expression, found {}", t.content);
+            advance_sibling();
+            if (!parse_numerical_expression()) {
+                syntaxError("Expected numerical expression after relational operator");
+            }
+            if (parenthesized) {
+                expect_sibling(R_PAREN);
+            }
+            return finish(true);
+        }
+
+        if (t.type == L_PAREN) {
+            parenthesized = true;
+            advance_sibling();
+        }
+
+        if (t.type == BOOLEAN_NOT) {
+            advance_sibling();
+        }
+
+        if (is_boolean_literal(t)) {
+            advance_sibling();
+            if (parenthesized) {
+                expect_sibling(R_PAREN);
+            }
+
+            return finish(true);
+        }
+
+        if (parse_call()) {
+            if (parenthesized) {
+                expect_sibling(R_PAREN);
+            }
+
+            if (is_boolean_operator(t)) {
+                advance_sibling();
+                chained = true;
+                missing = "Expected boolean expression";
+                continue;
+            }
+
+            return finish(true);
+        }
+
+        if (t.type == IDENTIFIER) {
+            advance_sibling();
+
+            if (is_boolean_operator(t)) {
+                advance_sibling();
+                chained = true;
+                missing = "Expected boolean expression";
+                closing += parenthesized;
+                continue;
+            }
+
+            if (parenthesized) {
+                expect_sibling(R_PAREN);
+            }
+
+            return finish(true);
+        }
+
+        if (parenthesized && parse_numerical_operand()) {
+            expect(is_relational_expression, "Expected relational operator after numerical operand, found {}", t.content);
+            advance_sibling();
+
+            if (parse_numerical_operand()) {
+                expect_sibling(R_PAREN);
+
+                // <BOOLEAN_OPERATOR> <BOOLEAN_EXPRESSION>
+                if (is_boolean_operator(t)) {
+                    advance_sibling();
+                    chained = true;
+                    missing = "expected boolean expression after boolean operator";
+                    continue;
+                }
+
+            } else if (parse_numerical_expression()) {
+                expect_sibling(R_PAREN);
+            } else {
+                syntaxError("Expected numerical value after numerical operand + relational expression");
+            }
+
+            return finish(true);
+        }
+
+        return finish(false);
+    }
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_relational_expression() {
+    if (is_relational_expression(t)) {
+        RuleScope scope(this, Rule::RelationalExpression);
+        advance_sibling();
+        return true;
+    }
+    return false;
+}
+
+/*
+<IDENTIFIER> |
+<INTEGER> |
+<IDENTIFIER> <L_BRACKET> <NUMERICAL EXPRESSION> <R_BRACKET> |
+<GETCHAR_FUNCTION> |
+<USER_DEFINED_FUNCTION> |
+<SINGLE_QUOTE> <CHARACTER> <SINGLE_QUOTE> |
+<SINGLE_QUOTE> <ESCAPED_CHARACTER> <SINGLE_QUOTE> |
+<DOUBLE_QUOTE> <CHARACTER> <DOUBLE_QUOTE> |
+<DOUBLE_QUOTE> <ESCAPED_CHARACTER> <DOUBLE_QUOTE> |
+<SIZEOF_FUNCTION>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_numerical_operand() {
+    RuleScope scope(this, Rule::NumericalOperand);
+    bool basic;
+    switch (keyword(t)) {
+        case Keyword::Getchar:
+            basic = parse_getchar();
+            break;
+        case Keyword::Sizeof:
+            basic = parse_sizeof();
+            break;
+        default:
+            basic = parse_call();
+            break;
+    }
+
+    if (basic) {
+        return true;
+    }
+
+    if (is_boolean_literal(t)) {
+        return false;
+    }
+
+    if (any(t, INTEGER, IDENTIFIER)) {
+        advance_sibling();
+        if (t.type == L_BRACKET) {
+            advance_sibling();
+            if (!parse_numerical_expression()) {
+                syntaxError("invalid array index");
+            }
+            expect_sibling(R_BRACKET);
+        }
+        return true;
+    } else if (any(t, SINGLE_QUOTE, DOUBLE_QUOTE)) {
+        TokenType quote_type = t.type;
+
+        advance_sibling();
+
+        if (!any(t, ESCAPED_CHARACTER, CHARACTER)) {
+            if (t.type == END) {
+                syntaxError("unterminated string quote.");
+            } else {
+                syntaxError("expected character or escaped character in quotes");
+            }
+        }
+
+        advance_sibling();
+
+        expect_sibling(quote_type);
+        return true;
+    }
+
+    return false;
+}
+
+/*
+<IDENTIFIER>
+<IDENTIFIER> <L_BRACKET> <IDENTIFIER> <R_BRACKET>
+<IDENTIFIER> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST>
+<IDENTIFIER> <L_BRACKET> <IDENTIFIER> <R_BRACKET> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST>
+<IDENTIFIER> <L_BRACKET> <NUMERICAL_EXPRESSION> <R_BRACKET>
+<IDENTIFIER> <L_BRACKET> <NUMERICAL_EXPRESSION> <R_BRACKET> <COMMA> <IDENTIFIER_AND_IDENTIFIER_ARRAY_PARAMETER_LIST>
+*/
+template <typename Handler>
+bool Parser<Handler>::parse_identifier_and_ident_arr_param_list() {
+    if (t.type != IDENTIFIER) {
+        return false;
+    }
+    RuleScope scope(this, Rule::IdentifierAndIdentArrParamList);
+
+    // loops on commas instead of recursing, so long lists don't grow the native stack
+    while (true) {
+        advance_sibling();
+
+        if (t.type == L_BRACKET) {
+            advance_sibling();  // l bracket
+            if (t.type == IDENTIFIER) {
+                advance_sibling();  // ident
+            } else if (!parse_numerical_expression()) {
+                syntaxError("Invalid array index in parameter list");
+            }
+            expect_sibling(R_BRACKET);
+        }
+
+        if (t.type != COMMA) {
+            return true;
+        }
+
+        advance_sibling();  // comma
+
+        if (t.type != IDENTIFIER) {
+            return true;
+        }
+    }
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_identifier_and_ident_arr_list() {
+    if (t.type != IDENTIFIER) {
+        return false;
+    }
+    RuleScope scope(this, Rule::IdentifierAndIdentArrList);
+
+    // loops on commas instead of recursing, like the parameter list
+    while (true) {
+        expect(not_reserved_word, "reserved word \"{}\" cannot be used for the name of a variable.", t.content);
+        advance_sibling();  // ident
+        if (t.type == L_BRACKET) {
+            advance_sibling();
+            if (!t.content.empty() && t.content[0] == '-') {
+                syntaxError("array declaration size must be a positive integer.");
+            }
+            expect_sibling(INTEGER);
+            expect_sibling(R_BRACKET);
+        }
+
+        if (t.type != COMMA) {
+            return true;
+        }
+        advance_sibling();
+
+        if (t.type != IDENTIFIER) {
+            return true;
+        }
+    }
+}
+
+// Goes straight to the one rule that can match the current token. Rules are still
+// tried in the order declaration, printf, selection, iteration, return, call statement,
+// assignment, so a keyword always wins over the call and assignment rules
+template <typename Handler>
+bool Parser<Handler>::parse_statement() {
+    RuleScope scope(this, Rule::Statement);
+    if (t.type != IDENTIFIER) {
+        return false;
+    }
+
+    switch (keyword(t)) {
+        case Keyword::Printf:
+            return parse_printf();
+        case Keyword::If:
+            return parse_selection();
+        case Keyword::For:
+        case Keyword::While:
+            return parse_iteration();
+        case Keyword::Return:
+            return parse_return();
+        case Keyword::Int:
+        case Keyword::Char:
+        case Keyword::Bool: {
+            // a data type can't be assigned to
+            TokenType next = tk->peek().type;
+            if (next == IDENTIFIER) {
+                return parse_declaration();
+            }
+            return next == L_PAREN && parse_call_statement();
+        }
+        default:
+            if (tk->peek().type == L_PAREN) {
+                return parse_call_statement();
+            }
+            return parse_assignment();
+    }
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_compound() {
+    RuleScope scope(this, Rule::Compound);
+    if constexpr (Handler::skim_bodies) {
+        return skim_compound();
+    }
+    // std::cout << "compound start on line " << tk->getLine() << " with " << t.content << "\n";
+    while (true) {
+        size_t before = nodes;
+        bool parsed = parse_statement();
+        if (panicking && nodes > before && (last == SEMICOLON || last == R_BRACE)) {
+            // the broken statement still ran to its own end, so the next one starts here
+            panicking = false;
+        } else if (panicking) {
+            if (!recover_statement()) {
+                break;
+            }
+        } else if (!parsed) {
+            break;
+        }
+    }
+    // std::cout << "compound end on line " << tk->getLine() << " with " << t.content << "\n";
+    return true;
+}
+
+// Panic mode recovery inside a block: skips to the end of the broken statement, which
+// is the next semicolon or a closing brace that balances the braces skipped so far.
+// Returns true if statements can follow, or false at the brace that closes the block,
+// the start of the next definition, or the end of the file
+template <typename Handler>
+bool Parser<Handler>::recover_statement() {
+    size_t braces = 0;
+    while (!halted && t.type != END) {
+        Keyword k = keyword(t);
+        if (k == Keyword::Function || k == Keyword::Procedure || (t.type == R_BRACE && braces == 0)) {
+            panicking = false;
+            return false;
+        }
+
+        if (t.type == L_BRACE) {
+            braces++;
+        } else if (t.type == R_BRACE) {
+            braces--;
+        }
+        bool end = (t.type == SEMICOLON && braces == 0) || (t.type == R_BRACE && braces == 0);
+        t = tk->next();
+
+        if (end) {
+            panicking = false;
+            return true;
+        }
+    }
+    // errors at the end of the file stay reported as one
+    return false;
+}
+
+// Panic mode recovery between definitions: skips to the next function, procedure or
+// global declaration. Declarations only count outside of braces, so the locals of a
+// body that is being skipped are not mistaken for globals
+template <typename Handler>
+void Parser<Handler>::recover_definition() {
+    if (!panicking) {
+        return;
+    }
+    size_t braces = 0;
+    while (!halted && t.type != END) {
+        Keyword k = keyword(t);
+        if (k == Keyword::Function || k == Keyword::Procedure ||
+            (braces == 0 && (k == Keyword::Int || k == Keyword::Char || k == Keyword::Bool))) {
+            panicking = false;
+            return;
+        }
+
+        if (t.type == L_BRACE) {
+            braces++;
+        } else if (t.type == R_BRACE && braces > 0) {
+            braces--;
+        }
+        t = tk->next();
+    }
+}
+
+// one definition, or a syntax error and the recovery to the next one. A definition
+// that fails on its first token hasn't consumed it, and the token can be a data type
+// the recovery would stop on again ("int 5;"), so it is skipped first. As the first
+// error, it is reported the way the parser did before it could recover, when it ended
+// the program there
+template <typename Handler>
+void Parser<Handler>::parse_definition_or_recover() {
+    if (!parse_definition() && !panicking) {
+        if (diagnostics.empty()) {
+            syntaxError("There should be no content after the end of the program");
+        } else {
+            syntaxError("Expected a function, procedure or declaration, got \"{}\" ({})", t.content, t.type);
+        }
+        t = tk->next();
+    }
+    recover_definition();
+}
+
+// Token level version of parse_compound() for handlers that set skim_bodies: skips
+// ahead to the brace that closes the compound statement, only stopping to parse
+// declarations
+template <typename Handler>
+bool Parser<Handler>::skim_compound() {
+    size_t depth = 0;
+    while (t.type != END) {
+        if (t.type == R_BRACE) {
+            if (depth == 0) {
+                break;
+            }
+            depth--;
+        } else if (t.type == L_BRACE) {
+            depth++;
+        } else if (parse_declaration()) {
+            continue;
+        }
+        advance_sibling();
+    }
+    return true;
+}
+
+// For handlers that set lazy_bodies: consumes a function body without parsing the
+// statements in it, so that they can be parsed later with parseBody()
+template <typename Handler>
+bool Parser<Handler>::defer_body() {
+    if constexpr (!Handler::lazy_bodies) {
+        return false;
+    } else {
+        if (t.type != L_BRACE || !ok()) {
+            return false;
+        }
+
+        Token open = t;
+        size_t line = tk->getLine();
+        advance_child();
+        h.deferred_body(open, line);
+
+        skip_block();
+        expect_child(R_BRACE);
+        return true;
+    }
+}
+
+// Moves to the brace that closes the current block, without reporting the tokens on the way
+template <typename Handler>
+void Parser<Handler>::skip_block() {
+    size_t depth = 0;
+    while (t.type != END && (t.type != R_BRACE || depth > 0)) {
+        if (t.type == L_BRACE) {
+            depth++;
+        } else if (t.type == R_BRACE) {
+            depth--;
+        }
+        t = tk->next();
+    }
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_parameter_decl() {
+    if (!is_datatype_specifier(t)) {
+        return false;
+    }
+    RuleScope scope(this, Rule::ParameterDecl);
+
+    h.add_param(tk->peek().content, to_datatype(t));
+
+    advance_sibling();
+
+    expect(not_reserved_word, "reserved word \"{}\" cannot be used for the name of a variable.", t.content);
+    expect_sibling(IDENTIFIER);
+
+    if (t.type == L_BRACKET) {
+        advance_sibling();
+        expect_sibling(INTEGER);
+        expect_sibling(R_BRACKET);
+    }
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_parameters() {
+    if (!is_datatype_specifier(t)) {
+        return false;
+    }
+    RuleScope scope(this, Rule::Parameters);
+
+    while (t.type != END) {
+        if (!parse_parameter_decl()) {
+            syntaxError("Invalid parameter list");
+        }
+
+        // after an error, leave the rest of the list to the recovery of the body
+        if (t.type == R_PAREN || panicking) {
+            break;
+        }
+
+        expect_sibling(COMMA);
+    }
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_procedure() {
+    if (t.content != "procedure") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Procedure);
+
+    advance_child();  // procedure
+
+    expect(not_reserved_word, "reserved word \"{}\" cannot be the name of a procedure", t.content);
+    h.enter_function(t.content, {});
+    expect_sibling(IDENTIFIER);  // name
+
+    expect_sibling(L_PAREN);
+
+    if (t.content == "void") {
+        advance_sibling();
+    } else {
+        if (!parse_parameters()) {
+            syntaxError("Invalid procedure parameter list");
+        }
+    }
+
+    expect_sibling(R_PAREN);
+
+    if (defer_body()) {
+        h.exit_function();
+        return true;
+    }
+
+    expect_child(L_BRACE);
+
+    parse_compound();
+
+    expect_child(R_BRACE);
+
+    h.exit_function();
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_function() {
+    if (t.content != "function") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Function);
+
+    advance_child();  // function
+
+    std::optional<Datatype> return_type;
+    if (expect(is_datatype_specifier, "Expected datatype specifier after function declaration")) {
+        return_type = to_datatype(t);
+    }
+
+    h.enter_function(tk->peek().content, return_type);
+    advance_sibling();  // return type
+
+    expect(not_reserved_word, "reserved word \"{}\" cannot be used for the name of a function.", t.content);
+    expect_sibling(IDENTIFIER);  // name
+
+    expect_sibling(L_PAREN);
+
+    if (t.content == "void") {
+        advance_sibling();
+    } else {
+        if (!parse_parameters()) {
+            syntaxError("Empty parameter list not allowed");
+        }
+    }
+
+    expect_sibling(R_PAREN);
+
+    if (defer_body()) {
+        h.exit_function();
+        return true;
+    }
+
+    expect_child(L_BRACE);
+
+    if (!parse_compound()) {
+        syntaxError("Empty function body not allowed: must have a valid return");
+    }
+
+    expect_child(R_BRACE);
+
+    h.exit_function();
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_program_tail() {
+    RuleScope scope(this, Rule::ProgramTail);
+    while (t.type != END) {
+        parse_definition_or_recover();
+    }
+
+    return true;
+}
+
+// a function, procedure or global declaration, picked by the keyword it starts with
+template <typename Handler>
+bool Parser<Handler>::parse_definition() {
+    switch (keyword(t)) {
+        case Keyword::Function:
+            return parse_function();
+        case Keyword::Procedure:
+            return parse_procedure();
+        case Keyword::Int:
+        case Keyword::Char:
+        case Keyword::Bool:
+            return parse_declaration();
+        default:
+            return false;
+    }
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_main() {
+    if (t.content != "procedure" || tk->peek().content != "main") {
+        return false;
+    }
+    RuleScope scope(this, Rule::Main);
+    advance_child();    // procedure
+    h.enter_function(t.content, {});
+    advance_sibling();  // main
+
+    
+
+    expect_sibling(L_PAREN);
+    expect("void", "Main procedure must have parameter type 'void', has {}", t.content);
+    advance_sibling();
+
+    expect_sibling(R_PAREN);
+
+    if (!parse_block()) {
+        syntaxError("Expected valid block statement following main declaration");
+    }
+
+    h.exit_function();
+
+    return true;
+}
+
+template <typename Handler>
+bool Parser<Handler>::parse_program() {
+    RuleScope scope(this, Rule::Program);
+    if (t.type != IDENTIFIER) {
+        syntaxError("Programs should start with an identifier");
+    }
+
+    while (t.type != END) {
+        if (keyword(t) == Keyword::Procedure && parse_main()) {
+            recover_definition();
+            parse_program_tail();
+            break;
+        }
+
+        parse_definition_or_recover();
+    }
+    expect(END, "There should be no content after the end of the program");
+
+    return true;
+}
+
+#endif /* PARSER_HPP */
@@ -0,0 +1,216 @@
+#include "resolution.hpp"
+
+#include <algorithm>
+
+#include "parser.hpp"
+
+// follows the rules the parser reported, so each token is handled by what it is part
+// of: a header, a parameter, a declaration, a call, or a statement that uses names
+struct Resolution::Walk : RuleWalker<Walk> {
+    Resolution& r;
+    const SymbolTable& table;
+
+    std::unordered_map<std::string_view, uint32_t> name_ids;
+    ScopeStack<Binding> scopes;
+
+    // the functions of the table, in the order their headers are in the tree
+    std::vector<uint32_t> functions;
+    size_t next_function = 0;
+
+    // a function has its own scope in the table, so it can't be looked up by scope
+    std::unordered_map<std::string_view, uint32_t> function_names;
+
+    uint32_t function = SymbolTable::NONE;  // the one the walk is in
+    uint32_t next_slot = 0;
+    std::vector<uint32_t> block_slots;  // next_slot when each open block started
+
+    // counts the lines up to each token as the walk reaches it
+    std::string_view source;
+    const char* counted;
+    size_t source_line = 1;
+
+    Walk(Resolution& r) : r(r), table(r.cst.table), source(r.cst.getSource()), counted(source.data()) {
+        size_t ids = 0;
+        for (uint32_t s : table.getSymbols()) {
+            ids = std::max<size_t>(ids, s + 1);
+            if (table.getKind(s) != SymbolTable::Kind::Variable) {
+                functions.push_back(s);
+                function_names.emplace(table.getName(s), s);
+            }
+        }
+        r.frame_sizes.resize(ids);
+        scopes.enter();
+    }
+
+    // the body of main is a block, but shares the scope of the function like the others
+    bool is_scope(Rule rule) const { return rule == Rule::Block && function != SymbolTable::NONE && this->rule(1) != Rule::Main; }
+
+    void enter(Rule rule) {
+        if (is_scope(rule)) {
+            scopes.enter();
+            block_slots.push_back(next_slot);
+        }
+    }
+
+    void exit(Rule rule) {
+        if (is_scope(rule)) {
+            scopes.leave();
+            next_slot = block_slots.back();
+            block_slots.pop_back();
+        } else if ((rule == Rule::Function || rule == Rule::Procedure || rule == Rule::Main) && function != SymbolTable::NONE) {
+            scopes.leave();
+            function = SymbolTable::NONE;
+        }
+    }
+
+    void node(const CstNode* n, size_t index) {
+        switch (rule()) {
+            case Rule::Function:
+                // function int name
+                if (index == 2) {
+                    header(n);
+                }
+                return;
+            case Rule::Procedure:
+            case Rule::Main:
+                if (index == 1) {
+                    header(n);
+                }
+                return;
+            case Rule::ParameterDecl:
+                // int name [ size ]
+                if (index == 1) {
+                    declare(n);
+                }
+                return;
+            case Rule::Declaration:
+                return;
+            case Rule::IdentifierAndIdentArrList:
+                // the sizes of arrays are integers, so every identifier is a name
+                if (n->t.type == IDENTIFIER) {
+                    declare(n);
+                }
+                return;
+            case Rule::Call:
+            case Rule::CallStatement:
+                if (index == 0) {
+                    call(n);
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+        use(n);
+    }
+
+    void header(const CstNode* name) {
+        function = next_function < functions.size() ? functions[next_function++] : SymbolTable::NONE;
+        if (function == SymbolTable::NONE || table.getName(function) != name->t.content) {
+            // the table has a function for every header that parsed
+            function = SymbolTable::NONE;
+            return;
+        }
+        bind(name, {Binding::Function, function, 0});
+
+        scopes.enter();
+        next_slot = 0;
+    }
+
+    void declare(const CstNode* n) {
+        uint32_t id = intern(n->t.content);
+        if (scopes.boundHere(id)) {
+            error(n, "\"{}\" is already declared in this scope", n->t.content);
+            return;
+        }
+
+        Binding b;
+        if (function == SymbolTable::NONE) {
+            b = {Binding::Global, SymbolTable::NONE, r.global_count++};
+        } else {
+            b = {Binding::Local, function, next_slot++};
+            r.frame_sizes[function] = std::max(r.frame_sizes[function], next_slot);
+        }
+        scopes.bind(id, b);
+        bind(n, b);
+    }
+
+    void call(const CstNode* n) {
+        auto callee = function_names.find(n->t.content);
+        if (callee == function_names.end()) {
+            error(n, "\"{}\" is not a declared function", n->t.content);
+        } else {
+            bind(n, {Binding::Function, callee->second, 0});
+        }
+    }
+
+    void use(const CstNode* n) {
+        if (n->t.type != IDENTIFIER || !ParserBase::not_reserved_word(n->t) || n->t.content == "else") {
+            return;
+        }
+        auto id = name_ids.find(n->t.content);
+        const Binding* b = id == name_ids.end() ? nullptr : scopes.find(id->second);
+        if (b) {
+            bind(n, *b);
+        } else {
+            error(n, "\"{}\" is not declared", n->t.content);
+        }
+    }
+
+    uint32_t intern(std::string_view name) {
+        return name_ids.try_emplace(name, static_cast<uint32_t>(name_ids.size())).first->second;
+    }
+
+    void bind(const CstNode* n, Binding b) {
+        r.bindings.emplace(n, b);
+        r.order.push_back(n);
+        r.lines.push_back(line_of(n));
+    }
+
+    template <typename... Args>
+    void error(const CstNode* n, std::format_string<Args...> fmt, Args&&... args) {
+        r.errors.push_back({line_of(n), std::format(fmt, std::forward<Args>(args)...)});
+    }
+
+    // tokens of edited definitions are not in the source, and keep the line before them
+    size_t line_of(const CstNode* n) {
+        const char* p = n->t.content.data();
+        if (p >= counted && p <= source.data() + source.size()) {
+            source_line += std::count(counted, p, '\n');
+            counted = p;
+        }
+        return source_line;
+    }
+};
+
+Resolution::Resolution(const Cst& cst) : cst(cst) {
+    if (!cst.ok()) {
+        return;
+    }
+    Walk(*this).walk(cst.getRules());
+}
+
+const Resolution::Binding* Resolution::getBinding(const CstNode* identifier) const {
+    auto found = bindings.find(identifier);
+    return found == bindings.end() ? nullptr : &found->second;
+}
+
+void Resolution::print(Writer& out) const {
+    const SymbolTable& table = cst.table;
+    for (size_t i = 0; i < order.size(); i++) {
+        const Binding& b = bindings.at(order[i]);
+        out << lines[i] << " | " << order[i]->t.content << " : ";
+        switch (b.kind) {
+            case Binding::Global:
+                out << "global " << b.index;
+                break;
+            case Binding::Local:
+                out << "local " << b.index << " of " << table.getName(b.function);
+                break;
+            case Binding::Function:
+                out << "function";
+                break;
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file resolution.hpp
+ * @author Hartley Blakey
+ * @brief Binds every identifier of a finished Cst to the variable or function it names
+ */
+
+#ifndef RESOLUTION_HPP
+#define RESOLUTION_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "cst.hpp"
+#include "scope_stack.hpp"
+#include "writer.hpp"
+
+/**
+ * @brief The result of resolving the names of a program, so that later passes can
+ * index arrays instead of looking names up.
+ *
+ * Globals are numbered in the order they are declared. The parameters of a function
+ * take the first slots of its frame, then each variable in a block takes the next
+ * slot, and the slots of a block are reused once it ends. Every name in a declaration
+ * gets a slot, including the ones after the first, which the SymbolTable leaves out.
+ * An array takes one slot.
+ *
+ * Variables have to be declared before they are used, while functions can be called
+ * anywhere, since they are found in the SymbolTable.
+ */
+class Resolution {
+   public:
+    struct Binding {
+        enum Kind : uint8_t {
+            Global,
+            Local,
+            Function,
+        };
+
+        Kind kind;
+        uint32_t function;  // the symbol id of the function, or SymbolTable::NONE for a global
+        uint32_t index;     // the global index, or the slot in the frame of the function
+    };
+
+    /**
+     * @brief Resolve every name of a Cst built with CstOptions::rules, by the rule each
+     * identifier is part of. Nothing is resolved if the Cst has a syntax error.
+     */
+    explicit Resolution(const Cst& cst);
+
+    /**
+     * @brief The binding of an identifier that names a variable or function, where it
+     * is declared or used, or nullptr for other nodes and undeclared names
+     */
+    const Binding* getBinding(const CstNode* identifier) const;
+
+    uint32_t getGlobalCount() const { return global_count; }
+
+    /**
+     * @brief How many slots a function needs for its parameters and variables at once
+     */
+    uint32_t getFrameSize(uint32_t function) const { return frame_sizes[function]; }
+
+    /**
+     * @brief Every name that is used without being declared, or declared twice in
+     * the same scope, in the order of the file
+     */
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+
+    bool ok() const { return errors.empty(); }
+
+    /**
+     * @brief Print every bound identifier in order, one per line, with the line it is on
+     */
+    void print(Writer& out) const;
+
+   private:
+    const Cst& cst;
+
+    std::unordered_map<const CstNode*, Binding> bindings;
+    std::vector<const CstNode*> order;  // of the bound identifiers
+    std::vector<size_t> lines;          // of the bound identifiers
+
+    uint32_t global_count = 0;
+    std::vector<uint32_t> frame_sizes;  // by symbol id
+    std::vector<Diagnostic> errors;
+
+    struct Walk;
+};
+
+#endif /* RESOLUTION_HPP */
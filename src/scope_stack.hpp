@@ -0,0 +1,92 @@
+/**
+ * @file scope_stack.hpp
+ * @author Hartley Blakey
+ * @brief The names visible at one point of a program, through nested block scopes
+ */
+
+#ifndef SCOPE_STACK_HPP
+#define SCOPE_STACK_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Lexical scopes as one flat vector of bindings, with an undo log of where the
+ * bindings of each open scope start.
+ *
+ * Names are interned ids, so the innermost binding of each name is kept in a vector
+ * indexed by id, and each binding remembers the one it shadows. Binding a name and
+ * finding it are O(1), entering a scope is O(1), and leaving one is O(1) per binding it
+ * made, without allocating per scope.
+ *
+ * @tparam Symbol What a name is bound to
+ */
+template <typename Symbol>
+class ScopeStack {
+   public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    void enter() { marks.push_back(static_cast<uint32_t>(bindings.size())); }
+
+    /**
+     * @brief Undo every binding made since the matching enter()
+     */
+    void leave() {
+        uint32_t mark = marks.back();
+        marks.pop_back();
+        while (bindings.size() > mark) {
+            const Binding& b = bindings.back();
+            innermost[b.name] = b.shadowed;
+            bindings.pop_back();
+        }
+    }
+
+    /**
+     * @brief Bind a name in the innermost scope, hiding any outer binding of it
+     * until that scope is left
+     */
+    void bind(uint32_t name, Symbol symbol) {
+        if (name >= innermost.size()) {
+            innermost.resize(name + 1, NONE);
+        }
+        bindings.push_back({name, innermost[name], symbol});
+        innermost[name] = static_cast<uint32_t>(bindings.size() - 1);
+    }
+
+    /**
+     * @brief The innermost binding of a name, or nullptr if it is not bound
+     */
+    const Symbol* find(uint32_t name) const {
+        if (name >= innermost.size() || innermost[name] == NONE) {
+            return nullptr;
+        }
+        return &bindings[innermost[name]].symbol;
+    }
+
+    /**
+     * @brief Whether the name is bound in the innermost scope itself, so binding it
+     * again would declare it twice there
+     */
+    bool boundHere(uint32_t name) const {
+        return name < innermost.size() && innermost[name] != NONE && (marks.empty() || innermost[name] >= marks.back());
+    }
+
+    /**
+     * @brief How many scopes are open
+     */
+    size_t depth() const { return marks.size(); }
+
+   private:
+    struct Binding {
+        uint32_t name;
+        uint32_t shadowed;  // the binding of the same name it hides, or NONE
+        Symbol symbol;
+    };
+
+    std::vector<Binding> bindings;
+    std::vector<uint32_t> marks;
+    std::vector<uint32_t> innermost;  // by name id, the index of its binding
+};
+
+#endif /* SCOPE_STACK_HPP */
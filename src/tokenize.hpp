@@ -3,7 +3,8 @@
 
 #include <string>
 #include <string_view>
-#include <deque>
+#include <cassert>
+#include <cstddef>
 #include <format>
 
 enum TokenType {
@@ -90,6 +91,44 @@ public:
     friend class Tokenizer;
 };
 
+/**
+ * @brief Fixed capacity double ended queue for the tokens the tokenizer has read
+ * ahead, so that queueing a token never allocates.
+ *
+ * At most two tokens are ever pending: the closing quote of a string, and the token
+ * read by peek().
+ */
+class TokenQueue {
+    static constexpr size_t CAPACITY = 4;
+
+    Token tokens[CAPACITY];
+    size_t first = 0;
+    size_t count = 0;
+
+public:
+    bool empty() const { return count == 0; }
+
+    Token front() const { return tokens[first]; }
+
+    void push_front(Token t) {
+        assert(count < CAPACITY);
+        first = (first + CAPACITY - 1) % CAPACITY;
+        tokens[first] = t;
+        count++;
+    }
+
+    void push_back(Token t) {
+        assert(count < CAPACITY);
+        tokens[(first + count) % CAPACITY] = t;
+        count++;
+    }
+
+    void pop_front() {
+        first = (first + 1) % CAPACITY;
+        count--;
+    }
+};
+
 // Without this, I would need 4x more explicit states to represent strings
 enum StringCharState {
     /// @brief An empty string
@@ -117,19 +156,28 @@ class Tokenizer {
 
     // When the tokenizer reaches the end of a string, it emits two tokens at once
     // (string and quote). If this is not empty, next() returns pending.front().
-    // deque needed for peek(), which is used in the CST parser. Otherwise single
-    // pending token would work. push_front() used in peek implementation prevents
-    // using std::queue instead.
-    std::deque<Token> pending;
+    // A double ended queue is needed for peek(), which is used in the CST parser.
+    // Otherwise single pending token would work. push_front() used in peek
+    // implementation prevents using std::queue instead.
+    TokenQueue pending;
 
 public:
     Tokenizer() = delete;
-    Tokenizer(std::string_view file) {
+    Tokenizer(std::string_view file) : Tokenizer(file, 0, 1) {}
+
+    /**
+     * @brief Start tokenizing part way through a file
+     *
+     * @param file The whole file, which the tokens will point into
+     * @param offset The index of the first character to read. Must not be inside a token
+     * @param line The line number of that character
+     */
+    Tokenizer(std::string_view file, size_t offset, size_t line) {
         this->file = file;
         state = START_STATE;
-        tokenStart = 0;
-        i = 0;
-        line = 1;
+        tokenStart = offset;
+        i = offset;
+        this->line = line;
         pending = {};
     }
 
@@ -172,6 +220,8 @@ public:
 
     size_t getLine() { return line; }
 
+    std::string_view getSource() { return file; }
+
 };
 
 template <>
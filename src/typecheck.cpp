@@ -0,0 +1,688 @@
+#include "typecheck.hpp"
+
+#include <algorithm>
+
+#include "parser.hpp"
+
+std::string_view typeName(Type t) {
+    switch (t) {
+        case Type::Void:
+            return "void";
+        case Type::Int:
+            return "int";
+        case Type::Char:
+            return "char";
+        case Type::Bool:
+            return "bool";
+        case Type::IntArray:
+            return "int[]";
+        case Type::CharArray:
+            return "char[]";
+        case Type::BoolArray:
+            return "bool[]";
+        default:
+            return "unknown";
+    }
+}
+
+namespace {
+
+bool is_number(Type t) {
+    return t == Type::Int || t == Type::Char;
+}
+
+bool is_array(Type t) {
+    return t == Type::IntArray || t == Type::CharArray || t == Type::BoolArray;
+}
+
+// the arrays are in the same order as the types of their elements
+Type element(Type array) {
+    return static_cast<Type>(static_cast<uint8_t>(array) - 3);
+}
+
+Type array_of(Type t) {
+    return static_cast<Type>(static_cast<uint8_t>(t) + 3);
+}
+
+Type to_type(SymbolTable::VariableType t) {
+    switch (t) {
+        case SymbolTable::Int:
+            return Type::Int;
+        case SymbolTable::Char:
+            return Type::Char;
+        case SymbolTable::Bool:
+            return Type::Bool;
+        default:
+            return Type::Unknown;
+    }
+}
+
+// nothing is wrong with a value that could not be typed, so one mistake is only reported once
+bool assignable(Type to, Type from) {
+    return to == Type::Unknown || from == Type::Unknown || to == from || (is_number(to) && is_number(from));
+}
+
+}  // namespace
+
+// follows the rules the parser reported like the Resolution, typing each expression
+// once its rule is done, and checking each statement once its own rule is
+struct TypeCheck::Walk : RuleWalker<Walk> {
+    TypeCheck& r;
+    const Resolution& names;
+    const SymbolTable& table;
+    const ExprPool& pool;
+
+    // what a rule has seen of its own tokens and of the expressions right inside of it
+    struct Open {
+        const CstNode* first = nullptr;   // like if or while
+        size_t line = 0;                  // of the first token
+        const CstNode* name = nullptr;    // being assigned, declared, called or passed
+        size_t name_line = 0;
+        Type type = Type::Unknown;        // of what a declaration declares
+        bool element = false;             // the name is followed by an index
+        bool indexing = false;            // inside the brackets of that index
+        bool assigned = false;            // past the = of an assignment
+        Type index = Type::Unknown;
+        Type value = Type::Unknown;
+    };
+    std::vector<Open> open;  // one for each rule the walk is in
+
+    // the nodes of the outermost expression rule the walk is in
+    std::vector<const CstNode*> expr_nodes;
+    size_t expr_line = 0;
+    unsigned expr_depth = 0;
+
+    // the node of every identifier, element and call of the expression trees
+    std::vector<const CstNode*> named;
+
+    std::vector<Type> globals;  // by global index
+    std::vector<Type> locals;   // by slot of the function the walk is in
+    uint32_t function = SymbolTable::NONE;
+
+    // the parameters of each function, by symbol id. Calls can come before the header
+    // of the function, so their arguments are only checked once the walk is done
+    struct Signature {
+        uint32_t first = SymbolTable::NONE;
+        uint32_t count = 0;
+    };
+    std::vector<Signature> signatures;
+    std::vector<Type> parameters;
+
+    struct Call {
+        uint32_t function;
+        uint32_t first;  // in arguments
+        uint32_t count;
+        size_t line;
+    };
+    std::vector<Call> calls;
+    std::vector<Type> arguments;
+
+    // of the call statement the walk is in, which the calls in its arguments go before
+    std::vector<Type> passed;
+
+    std::vector<std::pair<uint32_t, bool>> pending;  // expression nodes, and whether their operands are typed
+    std::vector<uint32_t> preorder;
+
+    // counts the lines up to each token as the walk reaches it
+    std::string_view source;
+    const char* counted;
+    size_t source_line = 1;
+
+    Walk(TypeCheck& r, const Resolution& names)
+        : r(r),
+          names(names),
+          table(r.cst.table),
+          pool(r.cst.getExpressions()),
+          named(pool.size(), nullptr),
+          source(r.cst.getSource()),
+          counted(source.data()) {
+        size_t ids = 0;
+        for (uint32_t s : table.getSymbols()) {
+            ids = std::max<size_t>(ids, s + 1);
+        }
+        signatures.resize(ids);
+    }
+
+    // operands and relational operators only appear inside of these, like in the Cst
+    static bool is_expression(Rule rule) {
+        return rule == Rule::Expression || rule == Rule::BooleanExpression || rule == Rule::NumericalExpression;
+    }
+
+    void enter(Rule rule) {
+        open.emplace_back();
+        if (rule == Rule::IdentifierAndIdentArrList) {
+            // the type of the declaration the list is in
+            open.back().type = open[open.size() - 2].type;
+        }
+        if (is_expression(rule) && expr_depth++ == 0) {
+            expr_nodes.clear();
+        }
+        if (rule == Rule::CallStatement) {
+            passed.clear();
+        }
+    }
+
+    void node(const CstNode* n, size_t index) {
+        Open& o = open.back();
+        size_t at = line_of(n->t);
+        if (index == 0) {
+            o.first = n;
+            o.line = at;
+        }
+        if (expr_depth > 0) {
+            if (expr_nodes.empty()) {
+                expr_line = at;
+            }
+            expr_nodes.push_back(n);
+            return;
+        }
+
+        TokenType type = n->t.type;
+        switch (rule()) {
+            case Rule::Function:
+                // function int name
+                if (index == 2) {
+                    header(n);
+                }
+                break;
+            case Rule::Procedure:
+            case Rule::Main:
+                if (index == 1) {
+                    header(n);
+                }
+                break;
+            case Rule::Declaration:
+                if (index == 0) {
+                    o.type = to_type(ParserBase::to_datatype(n->t));
+                }
+                break;
+            case Rule::IdentifierAndIdentArrList:
+                // a name, and the size of an array after it
+                if (type == IDENTIFIER) {
+                    declare_name(o);
+                    name(o, n, at);
+                } else if (type == L_BRACKET) {
+                    o.element = true;
+                }
+                break;
+            case Rule::ParameterDecl:
+                // int name [ size ]
+                if (index == 0) {
+                    o.type = to_type(ParserBase::to_datatype(n->t));
+                } else if (index == 1) {
+                    name(o, n, at);
+                } else if (type == L_BRACKET) {
+                    o.element = true;
+                }
+                break;
+            case Rule::Assignment:
+            case Rule::Initialization:
+                // name [ index ] = value
+                if (index == 0) {
+                    name(o, n, at);
+                } else if (type == L_BRACKET && !o.assigned) {
+                    o.element = true;
+                } else if (type == ASSIGNMENT_OPERATOR) {
+                    o.assigned = true;
+                } else if (o.assigned) {
+                    // the values that are not expressions
+                    if (type == STRING) {
+                        o.value = Type::CharArray;
+                    } else if (type == ESCAPED_CHARACTER) {
+                        o.value = Type::Char;
+                    } else if (type == IDENTIFIER) {
+                        o.value = variable(n);
+                    }
+                }
+                break;
+            case Rule::Return:
+                if (type == STRING) {
+                    o.value = Type::CharArray;
+                }
+                break;
+            case Rule::CallStatement:
+                if (index == 0) {
+                    name(o, n, at);
+                }
+                break;
+            case Rule::IdentifierAndIdentArrParamList:
+                // variables and elements of arrays, whose index can be an identifier too
+                if (rule(1) != Rule::CallStatement) {
+                    break;
+                }
+                if (type == IDENTIFIER && !o.indexing) {
+                    pass(o);
+                    name(o, n, at);
+                } else if (type == L_BRACKET) {
+                    o.element = true;
+                    o.indexing = true;
+                } else if (type == R_BRACKET) {
+                    o.indexing = false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    void exit(Rule rule) {
+        Open o = open.back();
+        open.pop_back();
+
+        if (is_expression(rule)) {
+            if (--expr_depth == 0 && !expr_nodes.empty()) {
+                expression();
+            }
+            return;
+        }
+
+        switch (rule) {
+            case Rule::IdentifierAndIdentArrList:
+                declare_name(o);
+                break;
+            case Rule::ParameterDecl:
+                parameter(o);
+                break;
+            case Rule::Assignment:
+            case Rule::Initialization:
+                assignment(o);
+                break;
+            case Rule::Return:
+                returned(o);
+                break;
+            case Rule::IdentifierAndIdentArrParamList:
+                if (this->rule(1) == Rule::CallStatement) {
+                    pass(o);
+                }
+                break;
+            case Rule::CallStatement:
+                call_statement(o);
+                break;
+            default:
+                break;
+        }
+    }
+
+    void name(Open& o, const CstNode* n, size_t at) {
+        o.name = n;
+        o.name_line = at;
+        o.element = false;
+    }
+
+    void header(const CstNode* name) {
+        const Resolution::Binding* b = names.getBinding(name);
+        if (!b || b->kind != Resolution::Binding::Function) {
+            function = SymbolTable::NONE;
+            return;
+        }
+        function = b->function;
+        locals.clear();
+        signatures[function] = {static_cast<uint32_t>(parameters.size()), 0};
+    }
+
+    void declare_name(const Open& o) {
+        if (o.name) {
+            declare(o.name, o.element ? array_of(o.type) : o.type);
+        }
+    }
+
+    void parameter(const Open& o) {
+        Type type = o.element ? array_of(o.type) : o.type;
+        declare(o.name, type);
+        if (function != SymbolTable::NONE) {
+            parameters.push_back(type);
+            signatures[function].count++;
+        }
+    }
+
+    void declare(const CstNode* n, Type type) {
+        const Resolution::Binding* b = n ? names.getBinding(n) : nullptr;
+        if (!b || b->kind == Resolution::Binding::Function) {
+            return;
+        }
+        std::vector<Type>& slots = b->kind == Resolution::Binding::Global ? globals : locals;
+        if (b->index >= slots.size()) {
+            slots.resize(b->index + 1, Type::Unknown);
+        }
+        slots[b->index] = type;
+    }
+
+    Type variable(const CstNode* n) const {
+        const Resolution::Binding* b = n ? names.getBinding(n) : nullptr;
+        if (!b || b->kind == Resolution::Binding::Function) {
+            return Type::Unknown;
+        }
+        const std::vector<Type>& slots = b->kind == Resolution::Binding::Global ? globals : locals;
+        return b->index < slots.size() ? slots[b->index] : Type::Unknown;
+    }
+
+    // the element of an array that an identifier names
+    Type indexed(Type array, std::string_view name, size_t at) {
+        if (is_array(array)) {
+            return element(array);
+        }
+        if (array != Type::Unknown) {
+            error(at, "\"{}\" is {}, not an array", name, typeName(array));
+        }
+        return Type::Unknown;
+    }
+
+    void index(std::string_view name, Type type, size_t at) {
+        if (type != Type::Unknown && !is_number(type)) {
+            error(at, "the index of \"{}\" is {}, not int", name, typeName(type));
+        }
+    }
+
+    // types the tree of the outermost expression rule that just ended, and gives its
+    // type to the rule it is in
+    void expression() {
+        uint32_t root = r.cst.getExpression(expr_nodes[0]);
+        if (root == ExprPool::NONE) {
+            return;
+        }
+        name_nodes(root);
+        type_tree(root, expr_line);
+        r.roots.push_back(root);
+        r.lines.push_back(expr_line);
+
+        // rule() is still the expression rule, so the rule it is in is rule(1)
+        Open& o = open.back();
+        Type type = r.types[root];
+        switch (rule(1)) {
+            case Rule::Selection:
+            case Rule::Iteration:
+                // the condition, the only expression right inside of them
+                if (type != Type::Unknown && type != Type::Bool) {
+                    error(expr_line, "the condition of {} is {}, not bool", o.first->t.content, typeName(type));
+                }
+                break;
+            case Rule::Assignment:
+            case Rule::Initialization:
+                (o.assigned ? o.value : o.index) = type;
+                break;
+            case Rule::Return:
+                o.value = type;
+                break;
+            case Rule::CallStatement:
+                passed.push_back(type);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // gives each identifier, element and call of a tree its node, from the nodes of
+    // the expression rule. The tree has them in the same order as the source if each
+    // node comes before its operands, which are in order
+    void name_nodes(uint32_t root) {
+        size_t next = 0;
+        preorder.push_back(root);
+        while (!preorder.empty()) {
+            uint32_t i = preorder.back();
+            preorder.pop_back();
+            const Expr& e = pool[i];
+
+            if (e.kind == Expr::Identifier || e.kind == Expr::Index || e.kind == Expr::Call) {
+                while (next < expr_nodes.size() && expr_nodes[next]->t.content != e.token.content) {
+                    next++;
+                }
+                if (next < expr_nodes.size()) {
+                    named[i] = expr_nodes[next++];
+                }
+            }
+
+            switch (e.kind) {
+                case Expr::Binary:
+                    preorder.push_back(e.rhs);
+                    [[fallthrough]];
+                case Expr::Unary:
+                case Expr::Index:
+                    preorder.push_back(e.lhs);
+                    break;
+                case Expr::Chain:
+                case Expr::Call: {
+                    std::span<const uint32_t> operands = pool.getOperands(e);
+                    for (auto it = operands.rbegin(); it != operands.rend(); ++it) {
+                        preorder.push_back(*it);
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    // operands before the nodes they belong to, without recursing, since trees can be
+    // as deep as ParseLimits::max_depth
+    void type_tree(uint32_t root, size_t at) {
+        pending.push_back({root, false});
+        while (!pending.empty()) {
+            auto [i, typed] = pending.back();
+            const Expr& e = pool[i];
+            if (typed) {
+                pending.pop_back();
+                r.types[i] = type_node(i, at);
+                continue;
+            }
+            pending.back().second = true;
+
+            switch (e.kind) {
+                case Expr::Binary:
+                    pending.push_back({e.rhs, false});
+                    [[fallthrough]];
+                case Expr::Unary:
+                case Expr::Index:
+                    pending.push_back({e.lhs, false});
+                    break;
+                case Expr::Chain:
+                case Expr::Call: {
+                    std::span<const uint32_t> operands = pool.getOperands(e);
+                    for (auto it = operands.rbegin(); it != operands.rend(); ++it) {
+                        pending.push_back({*it, false});
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    Type type_node(uint32_t i, size_t at) {
+        const Expr& e = pool[i];
+        switch (e.kind) {
+            case Expr::Identifier:
+                return variable(named[i]);
+
+            case Expr::Literal:
+                switch (e.token.type) {
+                    case INTEGER:
+                        return Type::Int;
+                    case CHARACTER:
+                    case ESCAPED_CHARACTER:
+                        return Type::Char;
+                    case STRING:
+                        return Type::CharArray;
+                    default:
+                        return Type::Bool;  // TRUE or FALSE
+                }
+
+            case Expr::Unary:
+                if (e.token.type == BOOLEAN_NOT) {
+                    operand(e.token, r.types[e.lhs], Type::Bool, at);
+                    return Type::Bool;
+                }
+                operand(e.token, r.types[e.lhs], Type::Int, at);
+                return Type::Int;
+
+            case Expr::Binary:
+                return binary(e, at);
+
+            case Expr::Chain: {
+                bool logical = e.token.type == BOOLEAN_AND || e.token.type == BOOLEAN_OR;
+                for (uint32_t o : pool.getOperands(e)) {
+                    operand(e.token, r.types[o], logical ? Type::Bool : Type::Int, at);
+                }
+                return logical ? Type::Bool : Type::Int;
+            }
+
+            case Expr::Index:
+                index(e.token.content, r.types[e.lhs], at);
+                return indexed(variable(named[i]), e.token.content, at);
+
+            case Expr::Call:
+                return call(i, at);
+        }
+        return Type::Unknown;
+    }
+
+    Type binary(const Expr& e, size_t at) {
+        Type lhs = r.types[e.lhs];
+        Type rhs = r.types[e.rhs];
+        if (e.token.type == CARET) {
+            operand(e.token, lhs, Type::Int, at);
+            operand(e.token, rhs, Type::Int, at);
+            return Type::Int;
+        }
+
+        // == and != also compare two bools
+        bool equality = e.token.type == BOOLEAN_EQUAL || e.token.type == BOOLEAN_NOT_EQUAL;
+        Type wanted = equality && (lhs == Type::Bool || rhs == Type::Bool) ? Type::Bool : Type::Int;
+        operand(e.token, lhs, wanted, at);
+        operand(e.token, rhs, wanted, at);
+        return Type::Bool;
+    }
+
+    // an int can be any number here
+    void operand(const Token& op, Type type, Type wanted, size_t at) {
+        if (type == Type::Unknown || type == wanted || (wanted == Type::Int && is_number(type))) {
+            return;
+        }
+        error(at, "operator \"{}\" cannot take {}", op.content, typeName(type));
+    }
+
+    Type call(uint32_t i, size_t at) {
+        const Expr& e = pool[i];
+        if (e.token.content == "getchar") {
+            return Type::Char;
+        }
+        if (e.token.content == "sizeof") {
+            return Type::Int;
+        }
+
+        const Resolution::Binding* b = names.getBinding(named[i]);
+        if (!b || b->kind != Resolution::Binding::Function) {
+            return Type::Unknown;
+        }
+        std::span<const uint32_t> operands = pool.getOperands(e);
+        calls.push_back({b->function, static_cast<uint32_t>(arguments.size()), static_cast<uint32_t>(operands.size()), at});
+        for (uint32_t o : operands) {
+            arguments.push_back(r.types[o]);
+        }
+        return returns(b->function);
+    }
+
+    Type returns(uint32_t f) const {
+        return table.getKind(f) == SymbolTable::Kind::Procedure ? Type::Void : to_type(table.getType(f));
+    }
+
+    void returned(const Open& o) {
+        if (function == SymbolTable::NONE || table.getKind(function) != SymbolTable::Kind::Function) {
+            return;
+        }
+        Type wanted = returns(function);
+        if (!assignable(wanted, o.value)) {
+            error(o.line, "{} returns {}, not {}", table.getName(function), typeName(wanted), typeName(o.value));
+        }
+    }
+
+    void assignment(const Open& o) {
+        std::string_view name = o.name->t.content;
+        Type wanted = variable(o.name);
+        if (o.element) {
+            index(name, o.index, o.name_line);
+            wanted = indexed(wanted, name, o.name_line);
+        }
+        if (!assignable(wanted, o.value)) {
+            error(o.name_line, "cannot assign {} to \"{}\", which is {}", typeName(o.value), name, typeName(wanted));
+        }
+    }
+
+    // a variable, or an element of an array, of the parameter list of a call statement
+    void pass(const Open& o) {
+        if (o.name) {
+            Type type = variable(o.name);
+            passed.push_back(o.element ? indexed(type, o.name->t.content, o.name_line) : type);
+        }
+    }
+
+    // the arguments are a parameter list, or a single expression
+    void call_statement(const Open& o) {
+        const Resolution::Binding* b = names.getBinding(o.name);
+        if (!b || b->kind != Resolution::Binding::Function) {
+            return;
+        }
+        calls.push_back({b->function, static_cast<uint32_t>(arguments.size()), static_cast<uint32_t>(passed.size()), o.name_line});
+        arguments.insert(arguments.end(), passed.begin(), passed.end());
+    }
+
+    void check_calls() {
+        for (const Call& c : calls) {
+            const Signature& s = signatures[c.function];
+            if (s.first == SymbolTable::NONE) {
+                continue;
+            }
+            std::string_view name = table.getName(c.function);
+            if (c.count != s.count) {
+                error(c.line, "{} takes {} arguments, not {}", name, s.count, c.count);
+                continue;
+            }
+            for (uint32_t i = 0; i < c.count; i++) {
+                Type wanted = parameters[s.first + i];
+                Type type = arguments[c.first + i];
+                if (!assignable(wanted, type)) {
+                    error(c.line, "argument {} of {} is {}, not {}", i + 1, name, typeName(type), typeName(wanted));
+                }
+            }
+        }
+    }
+
+    template <typename... Args>
+    void error(size_t at, std::format_string<Args...> fmt, Args&&... args) {
+        r.errors.push_back({at, std::format(fmt, std::forward<Args>(args)...)});
+    }
+
+    // tokens of edited definitions are not in the source, and keep the line before them
+    size_t line_of(const Token& t) {
+        const char* p = t.content.data();
+        if (p >= counted && p <= source.data() + source.size()) {
+            source_line += std::count(counted, p, '\n');
+            counted = p;
+        }
+        return source_line;
+    }
+};
+
+TypeCheck::TypeCheck(const Cst& cst, const Resolution& names) : cst(cst) {
+    if (!cst.ok() || !names.ok()) {
+        return;
+    }
+    types.assign(cst.getExpressions().size(), Type::Unknown);
+
+    Walk walk(*this, names);
+    walk.walk(cst.getRules());
+    walk.check_calls();
+
+    // the arguments of every call are checked last
+    std::stable_sort(errors.begin(), errors.end(), [](const Diagnostic& a, const Diagnostic& b) { return a.line < b.line; });
+}
+
+void TypeCheck::print(Writer& out) const {
+    const ExprPool& pool = cst.getExpressions();
+    for (size_t i = 0; i < roots.size(); i++) {
+        out << lines[i] << " | ";
+        pool.print(out, roots[i]);
+        out << " : " << typeName(types[roots[i]]) << "\n";
+    }
+}
@@ -0,0 +1,84 @@
+/**
+ * @file typecheck.hpp
+ * @author Hartley Blakey
+ * @brief Gives every expression of a resolved Cst its static type, and rejects the
+ * ones that mix types
+ */
+
+#ifndef TYPECHECK_HPP
+#define TYPECHECK_HPP
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "cst.hpp"
+#include "resolution.hpp"
+#include "writer.hpp"
+
+/**
+ * @brief The type of a value. A char array is also the type of a string literal.
+ */
+enum class Type : uint8_t {
+    Unknown,  // of an expression that could not be typed, which is never an error again
+    Void,     // of a call to a procedure
+    Int,
+    Char,
+    Bool,
+    IntArray,
+    CharArray,
+    BoolArray,
+};
+
+std::string_view typeName(Type t);
+
+/**
+ * @brief The static type of every node of every expression tree of a Cst, so that a
+ * back end never has to check a type at run time.
+ *
+ * int and char are both numbers, and can be assigned to each other. Arithmetic and
+ * ordering take numbers and give an int, && || and ! take bools, and == and != take
+ * two numbers or two bools. Conditions have to be bools. A value can only be assigned,
+ * returned or passed where its type can be assigned, and calls have to pass one
+ * argument for each parameter. Arrays are passed whole, but not assigned, except for
+ * a string to a char array.
+ */
+class TypeCheck {
+   public:
+    /**
+     * @brief Type every expression of a Cst built with CstOptions::expressions and
+     * CstOptions::rules. Nothing is checked if the names did not resolve.
+     */
+    TypeCheck(const Cst& cst, const Resolution& names);
+
+    /**
+     * @brief The type of a node of Cst::getExpressions()
+     */
+    Type getType(uint32_t expr) const { return expr < types.size() ? types[expr] : Type::Unknown; }
+
+    /**
+     * @brief Every mismatch, in the order of the file
+     */
+    const std::vector<Diagnostic>& getErrors() const { return errors; }
+
+    bool ok() const { return errors.empty(); }
+
+    /**
+     * @brief Print the tree of every expression in order, one per line, with the line
+     * it is on and its type
+     */
+    void print(Writer& out) const;
+
+   private:
+    const Cst& cst;
+
+    std::vector<Type> types;  // by expression node
+    std::vector<uint32_t> roots;
+    std::vector<size_t> lines;  // of the roots
+
+    std::vector<Diagnostic> errors;
+
+    struct Walk;
+};
+
+#endif /* TYPECHECK_HPP */
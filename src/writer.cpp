@@ -0,0 +1,48 @@
+#include "writer.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+void Writer::append(const char* data, size_t length) {
+    if (used + length > buffer.size()) {
+        flush();
+
+        // too big to be worth copying into the buffer
+        if (length > buffer.size()) {
+            if (copy) {
+                copy->append(data, length);
+            }
+            while (length > 0 && !failed && fd >= 0) {
+                ssize_t n = ::write(fd, data, length);
+                if (n > 0) {
+                    data += n;
+                    length -= n;
+                } else if (n == 0 || errno != EINTR) {
+                    // nothing written would otherwise retry forever
+                    failed = true;
+                }
+            }
+            return;
+        }
+    }
+
+    std::memcpy(buffer.data() + used, data, length);
+    used += length;
+}
+
+bool Writer::flush() {
+    if (copy) {
+        copy->append(buffer.data(), used);
+    }
+    size_t written = 0;
+    while (written < used && !failed && fd >= 0) {
+        ssize_t n = ::write(fd, buffer.data() + written, used - written);
+        if (n > 0) {
+            written += n;
+        } else if (n == 0 || errno != EINTR) {
+            failed = true;
+        }
+    }
+    used = 0;
+    return !failed;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file writer.hpp
+ * @author Hartley Blakey
+ * @brief Buffered output used for the token, CST and symbol table dumps
+ */
+
+#ifndef WRITER_HPP
+#define WRITER_HPP
+
+#include <charconv>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * @brief Output stream that collects everything written to it in one reusable
+ * buffer, and hands the buffer to the OS with a single write(2) call whenever it
+ * fills up, when flush() is called, or when the writer is destroyed.
+ *
+ * Anything else writing to the same file descriptor (like std::cout) must be
+ * flushed before the writer is, or the output will be out of order. A writer can
+ * also have no file descriptor, and only append its output to a string.
+ */
+class Writer {
+    int fd;
+    std::vector<char> buffer;
+    size_t used;
+    bool failed;
+    std::string* copy = nullptr;
+
+    void append(const char* data, size_t length);
+
+   public:
+    static constexpr size_t DEFAULT_CAPACITY = 1 << 16;
+
+    Writer() = delete;
+    Writer(int fd, size_t capacity = DEFAULT_CAPACITY) {
+        this->fd = fd;
+        buffer.resize(capacity);
+        used = 0;
+        failed = false;
+    }
+
+    /**
+     * @brief Append everything written to a string instead of a file descriptor
+     */
+    explicit Writer(std::string* into, size_t capacity = DEFAULT_CAPACITY) : Writer(-1, capacity) {
+        copy = into;
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() {
+        flush();
+    }
+
+    Writer& operator<<(std::string_view s) {
+        append(s.data(), s.size());
+        return *this;
+    }
+
+    Writer& operator<<(char c) {
+        append(&c, 1);
+        return *this;
+    }
+
+    /**
+     * @brief Write an integer in decimal, formatted with std::to_chars
+     */
+    template <typename T>
+        requires(std::is_integral_v<T> && !std::is_same_v<T, char> && !std::is_same_v<T, bool>)
+    Writer& operator<<(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        append(digits, result.ptr - digits);
+        return *this;
+    }
+
+    /**
+     * @brief Write the buffered output to the file descriptor
+     *
+     * @return true if everything written so far reached the file descriptor
+     * @return false if any write failed, or wrote nothing
+     */
+    bool flush();
+
+    /**
+     * @brief Drop any buffered output that has not been flushed yet
+     */
+    void discard() { used = 0; }
+
+    /**
+     * @brief Also append everything written to the file descriptor from now on to a
+     * string, or stop doing so if it is nullptr. Discarded output is not copied.
+     * A writer without a file descriptor that stops copying drops its output.
+     */
+    void capture(std::string* into) { copy = into; }
+};
+
+#endif /* WRITER_HPP */
@@ -1,50 +1,116 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <string_view>
 #include <vector>
 
+#include "cache.hpp"
 #include "comments.hpp"
 #include "tokenize.hpp"
 #include "cst.hpp"
+#include "cst_file.hpp"
+#include "resolution.hpp"
+#include "typecheck.hpp"
+#include "writer.hpp"
 
-int main(int argc, char* argv[]) {
-
-    if (argc != 2) {
-        std::cout << "Usage: tokenize path/to/my-file.c\n";
-        return 1;
-    }
-
-    std::ifstream inputFile(argv[1]);
-
-    if (!inputFile.is_open()) {
-        std::cout << "ERROR: Failed to open file\n";
-        return 2;
-    }
-
-    // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
-    auto size = std::filesystem::file_size(argv[1]);
-    std::string content(size, '\0');
-    inputFile.read(&content[0], size);
-
+static int run(Writer& out, std::string& content, bool declarationsOnly, bool resolve, bool types, ParseLimits limits) {
     // strip comments
     std::string commentsError = removeComments(content);
     if (!commentsError.empty()) {
-        std::cout << commentsError;
+        out << commentsError;
         return 3;
     }
 
     Tokenizer tokenizer(content);
 
-    Cst cst(&tokenizer);
+    Cst cst(&tokenizer, CstOptions{.declarations_only = declarationsOnly, .expressions = types, .rules = resolve || types, .limits = limits});
 
     if (!cst.ok()) {
-        std::cout << cst.getError() << "\n";
+        out << cst.getError() << "\n";
+        if (cst.getStatus() != ParseStatus::SyntaxError) {
+            return 6;
+        }
+    } else if (resolve || types) {
+        Resolution names(cst);
+        for (const Diagnostic& d : names.getErrors()) {
+            out << "Name error on line " << d.line << ": " << d.message << "\n";
+        }
+        if (!names.ok()) {
+            return 4;
+        }
+        if (resolve) {
+            names.print(out);
+            out << "\n";
+            return 0;
+        }
+
+        TypeCheck checked(cst, names);
+        for (const Diagnostic& d : checked.getErrors()) {
+            out << "Type error on line " << d.line << ": " << d.message << "\n";
+        }
+        if (!checked.ok()) {
+            return 7;
+        }
+        checked.print(out);
+        out << "\n";
     } else {
         
-        cst.table.print();
-        std::cout << "\n";
+        cst.table.print(out);
+        out << "\n";
     }
 
-
     return 0;
+}
+
+int main(int argc, char* argv[]) {
+
+    // --decls-only: skim function bodies, only parsing the declarations in them
+    // --load:       print the symbols saved in a file by cst --save, without parsing anything
+    // --resolve:    print what each identifier is bound to instead, or every name that isn't declared
+    // --types:      print the type of every expression instead, or every value of the wrong type
+    //
+    // Exits with 4 if a name isn't declared (--resolve and --types), with 7 if a value has the
+    // wrong type (--types), and with 6 if the parse goes over a limit, see
+    // ParseLimits::fromEnvironment(). 5 is left for cst, which exits with it if --save fails
+    bool declarationsOnly = argc == 3 && std::string_view(argv[1]) == "--decls-only";
+    bool load = argc == 3 && std::string_view(argv[1]) == "--load";
+    bool resolve = argc == 3 && std::string_view(argv[1]) == "--resolve";
+    bool types = argc == 3 && std::string_view(argv[1]) == "--types";
+
+    if (argc != 2 && !declarationsOnly && !load && !resolve && !types) {
+        std::cout << "Usage: symbols [--decls-only | --load | --resolve | --types] path/to/my-file.c\n";
+        return 1;
+    }
+
+    const char* path = argv[argc - 1];
+
+    if (load) {
+        CstFile file(path);
+        if (!file.ok()) {
+            std::cout << file.getError() << "\n";
+            return 2;
+        }
+        Writer out(STDOUT_FILENO);
+        file.printSymbols(out);
+        out << "\n";
+        return 0;
+    }
+
+    std::ifstream inputFile(path);
+
+    if (!inputFile.is_open()) {
+        std::cout << "ERROR: Failed to open file\n";
+        return 2;
+    }
+
+    // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
+    auto size = std::filesystem::file_size(path);
+    std::string content(size, '\0');
+    inputFile.read(&content[0], size);
+
+    ParseLimits limits = ParseLimits::fromEnvironment();
+    std::string stage = argc == 3 ? "symbols " + std::string(argv[1]) : "symbols";
+    Cache cache(stage + limits.describe(), content);
+    Writer out(STDOUT_FILENO);
+    return cache.run(out, [&] { return run(out, content, declarationsOnly, resolve, types, limits); });
 }
\ No newline at end of file
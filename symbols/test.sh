@@ -1,7 +1,11 @@
 #!/bin/bash
 
 # diff the output with the expected result
-# the diff output is piped into cat -A to highlight trailing whitespace 
+# the diff output is piped into cat -A to highlight trailing whitespace
+#
+# tests in a subdirectory of $TESTS are run with the option of the same name (the
+# tests in $TESTS/types with --types), and compared to the same subdirectory of
+# $EXPECTED
 
 TESTS=tests
 EXPECTED=expected
@@ -10,7 +14,7 @@ OUTPUT=output
 TEST_EXT=c
 OUTPUT_EXT=txt
 
-BINARY=build/cst
+BINARY=build/symbols
 
 if [ -d "$TESTS" ] && [ -d "$EXPECTED" ]; then
     mkdir -p "$OUTPUT"
@@ -29,29 +33,43 @@ if [ ! -x "$BINARY" ]; then
     exit 1
 fi
 
-shopt -s nullglob
-for i in "$TESTS"/*.$TEST_EXT; do
-    echo "Testing file $i:";
-    BN=$(basename "$i" .$TEST_EXT)
-    "$BINARY" "$i" > "$OUTPUT/o$BN.$OUTPUT_EXT"
-    if [ ! -f "$OUTPUT/o$BN.$OUTPUT_EXT" ]; then
-        echo -e "\e[1;31mFailed to create file \"$OUTPUT/o$BN.$OUTPUT_EXT\"\e[0m"
-        exit 1
-    fi
-    if [ ! -f "$EXPECTED/e$BN.$OUTPUT_EXT" ]; then
-        echo -e "\e[1;31mNo matching reference file \"$EXPECTED/e$BN.$OUTPUT_EXT\"\e[0m"
-        exit 1
-    fi
-    DIFF=$(diff "$OUTPUT/o$BN.$OUTPUT_EXT" "$EXPECTED/e$BN.$OUTPUT_EXT" | cat -A)
-    if [ -n "$DIFF" ]; then
-        echo -e "\e[0;33mDifferences between $OUTPUT/o$BN.$OUTPUT_EXT and $EXPECTED/e$BN.$OUTPUT_EXT:\e[0m"
-        echo "$DIFF"
-        echo -e "\e[1;31mSome test(s) failed\e[0m"
-        exit 1
+# run_test <test file> <mode, or empty for the default> <output file>
+run_test() {
+    if [ -z "$2" ]; then
+        "$BINARY" "$1" > "$3"
+    else
+        "$BINARY" "--$2" "$1" > "$3"
     fi
+}
+
+shopt -s nullglob
+for DIR in "" $(cd "$TESTS" && ls -d */ 2>/dev/null | tr -d /); do
+    mkdir -p "$OUTPUT/$DIR"
+    for i in "$TESTS/${DIR:+$DIR/}"*.$TEST_EXT; do
+        echo "Testing file $i${DIR:+ (--$DIR)}:";
+        BN=$(basename "$i" .$TEST_EXT)
+        OUT="$OUTPUT/${DIR:+$DIR/}o$BN.$OUTPUT_EXT"
+        REF="$EXPECTED/${DIR:+$DIR/}e$BN.$OUTPUT_EXT"
+        run_test "$i" "$DIR" "$OUT"
+        if [ ! -f "$OUT" ]; then
+            echo -e "\e[1;31mFailed to create file \"$OUT\"\e[0m"
+            exit 1
+        fi
+        if [ ! -f "$REF" ]; then
+            echo -e "\e[1;31mNo matching reference file \"$REF\"\e[0m"
+            exit 1
+        fi
+        DIFF=$(diff "$OUT" "$REF" | cat -A)
+        if [ -n "$DIFF" ]; then
+            echo -e "\e[0;33mDifferences between $OUT and $REF:\e[0m"
+            echo "$DIFF"
+            echo -e "\e[1;31mSome test(s) failed\e[0m"
+            exit 1
+        fi
+    done
 done
 
-if test -n "$(find "$TESTS" -maxdepth 1 -name "*.$TEST_EXT" -print -quit)"; then
+if test -n "$(find "$TESTS" -name "*.$TEST_EXT" -print -quit)"; then
     echo -e "\e[1;32mAll tests passed\e[0m"
 else
     echo -e "\e[1;33mNo tests found in $TESTS\e[0m"
@@ -0,0 +1,22 @@
+// only the declarations of a body are parsed, so the broken statements around them
+// are not reported
+
+int total;
+
+function int count (char text[16], int limit)
+{
+  int i, n;
+  n = = 0;
+  for (i = 0; i < limit; i = i + 1)
+  {
+    char c;
+    c = text[i] +;
+  }
+  return n;
+}
+
+procedure main (void)
+{
+  bool done;
+  done = count ("abc", 3) < ;
+}
@@ -0,0 +1,8 @@
+// declarations are still parsed in full, so an error in one is reported
+
+procedure main (void)
+{
+  int x;
+  x = 1;
+  int y z;
+}
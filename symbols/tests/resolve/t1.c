@@ -0,0 +1,36 @@
+// globals are numbered in order, parameters take the first slots of a frame, and the
+// slots of a block are reused once it ends. Functions can be called before they are
+// defined
+
+int total, limit;
+
+function int add (int a, int b)
+{
+  int sum;
+  sum = a + b;
+  return sum;
+}
+
+procedure main (void)
+{
+  int x, list[4];
+  x = 0;
+  if (x < limit)
+  {
+    int inner;
+    inner = add (x, total);
+    list[inner] = later (inner);
+  }
+  while (x < 3)
+  {
+    int x, other;
+    x = 1;
+    other = x;
+  }
+  total = x + sizeof (list);
+}
+
+function int later (int n)
+{
+  return n * 2;
+}
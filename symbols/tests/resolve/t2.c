@@ -0,0 +1,19 @@
+// a use before any declaration, an undeclared function, a use after the block that
+// declared it, and a second declaration in the same scope
+
+int total;
+
+procedure main (void)
+{
+  int x;
+  x = y + 1;
+  undefined (x);
+  if (x > 0)
+  {
+    int z;
+    z = x;
+  }
+  z = 1;
+  total = x;
+  int x;
+}
@@ -0,0 +1,23 @@
+// a block variable that hides a local, which hides a global
+
+int x;
+
+procedure main (void)
+{
+  int x;
+
+  x = 1;
+  if (x > 0)
+  {
+    int x;
+
+    x = 2;
+    printf ("%d\n", x);
+  }
+  printf ("%d\n", x);
+}
+
+procedure show (void)
+{
+  printf ("%d\n", x);
+}
@@ -0,0 +1,34 @@
+// ints and chars mix in arithmetic, comparisons and && give bools, and calls give
+// the return type of the function
+
+function int digit (char c)
+{
+  return c - '0';
+}
+
+function bool small (int n)
+{
+  return n < 10;
+}
+
+procedure main (void)
+{
+  char text[8];
+  int values[4];
+  int i, n;
+  bool ok;
+
+  text = "1234567";
+  n = 0;
+  for (i = 0; i < 4; i = i + 1)
+  {
+    values[i] = digit (text[i]) * 2 ^ i;
+    n = n + values[i] % 7;
+  }
+  ok = n != 3;
+  if ((!small (n)) && (n < 1))
+  {
+    n = getchar (void);
+  }
+  printf ("%d\n", n);
+}
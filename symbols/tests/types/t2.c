@@ -0,0 +1,59 @@
+// every kind of type error, with the ones about the arguments of a call reported on
+// the line of the call
+
+function int twice (int n)
+{
+  return n * 2;
+}
+
+function bool positive (int n)
+{
+  return n > 0;
+}
+
+procedure show (char text[8], int count)
+{
+  int i;
+  for (i = TRUE; i < count; i = i + 1)
+  {
+    printf ("%s\n", text);
+  }
+}
+
+function char first (char text[8])
+{
+  return TRUE;
+}
+
+procedure main (void)
+{
+  int x, y;
+  bool b;
+  char name[8];
+  int list[4];
+
+  x = 1;
+  b = x;
+  y = twice (b);
+  x = twice (x) + positive (x);
+  if ((!twice (x)) && (x < 1))
+  {
+    x = 0;
+  }
+  while ((!positive (x)) && (x < 3))
+  {
+    b = FALSE;
+  }
+  list[b] = 3;
+  x[0] = 2;
+  name = "abcdefg";
+  x = "string";
+  show (name, x);
+  show (name);
+  show (x, name);
+  y = positive (x, y);
+  b = !x;
+  x = -b;
+  list = 2;
+  x = first (name) + list[1];
+}
@@ -12,32 +12,16 @@
 #include <filesystem>
 #include <vector>
 
+#include "cache.hpp"
 #include "comments.hpp"
 #include "tokenize.hpp"
+#include "writer.hpp"
 
-int main(int argc, char* argv[]) {
-
-    if (argc != 2) {
-        std::cout << "Usage: tokenize path/to/my-file.c\n";
-        return 1;
-    }
-
-    std::ifstream inputFile(argv[1]);
-
-    if (!inputFile.is_open()) {
-        std::cout << "ERROR: Failed to open file\n";
-        return 2;
-    }
-
-    // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
-    auto size = std::filesystem::file_size(argv[1]);
-    std::string content(size, '\0');
-    inputFile.read(&content[0], size);
-
+static int run(Writer& out, std::string& content) {
     // strip comments
     std::string commentsError = removeComments(content);
     if (!commentsError.empty()) {
-        std::cout << commentsError;
+        out << commentsError;
         return 3;
     }
 
@@ -53,18 +37,42 @@ int main(int argc, char* argv[]) {
             break;
         }
     }
- 
+
     if (tokenizer.ok()) {
-        std::cout << "\nToken list:\n\n";
+        out << "\nToken list:\n\n";
         for (Token t : tokens) {
-            std::cout << "Token type: " << tokenTypeName(t.type) << "\n";
-            std::cout << "Token:      " << t.content << "\n";
-            std::cout << "\n";
+            out << "Token type: " << tokenTypeName(t.type) << "\n";
+            out << "Token:      " << t.content << "\n";
+            out << "\n";
         }
-        std::cout << "\n";
+        out << "\n";
     } else {
-        std::cout << tokenizer.getError() << "\n";
+        out << tokenizer.getError() << "\n";
     }
 
     return 0;
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 2) {
+        std::cout << "Usage: tokenize path/to/my-file.c\n";
+        return 1;
+    }
+
+    std::ifstream inputFile(argv[1]);
+
+    if (!inputFile.is_open()) {
+        std::cout << "ERROR: Failed to open file\n";
+        return 2;
+    }
+
+    // https://stackoverflow.com/questions/2602013/read-whole-ascii-file-into-c-stdstring
+    auto size = std::filesystem::file_size(argv[1]);
+    std::string content(size, '\0');
+    inputFile.read(&content[0], size);
+
+    Cache cache("tokenize", content);
+    Writer out(STDOUT_FILENO);
+    return cache.run(out, [&] { return run(out, content); });
 }
\ No newline at end of file